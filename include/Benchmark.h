@@ -0,0 +1,4 @@
+#pragma once
+
+// Micro-benchmarks of the chunk code, run with `./app --bench` (no window needed)
+int runBenchmarks();
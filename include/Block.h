@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+enum BlockType : uint8_t {
+    AIR,
+    DIRT,
+    GRASS,
+    STONE,
+    WOOD,
+    LEAF,
+    SAND,
+    PUMPKIN,
+    SNOW,
+    COBBLESTONE,
+    BRICK,
+    PLANKS,
+    IRON_ORE,
+
+    BLOCK_TYPE_COUNT // keep last
+};
+
+// A block is only its type: its position is implied by where it is stored
+// (see BlockRef in Chunk.h to get it back)
+struct Block {
+    BlockType type;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "World.h"
+
+// Cursor over the blocks of a World that remembers the chunk of its last
+// query. Runs of nearby queries (collision box, raycast steps, neighbours)
+// then only look the chunk up again when they cross a chunk border, instead
+// of going through World::getChunkAt for every block.
+//
+// Meant to live for one batch of queries: the cached Chunk* is not checked
+// again, so don't keep an accessor across frames or chunk unloads.
+class BlockAccessor {
+public:
+    explicit BlockAccessor(World& world, const glm::ivec3& worldPos = glm::ivec3(0))
+        : world(world), pos(worldPos) {}
+
+    // Cursor
+    const glm::ivec3& position() const { return pos; }
+    void moveTo(const glm::ivec3& worldPos) { pos = worldPos; }
+    void move(const glm::ivec3& delta) { pos += delta; }
+    // One axis (0 = x, 1 = y, 2 = z), like a DDA step
+    void step(int axis, int delta) { pos[axis] += delta; }
+
+    Block get() { return getBlockAt(pos); }
+    bool isSolid() { return isBlockSolid(pos); }
+    // Block at cursor + offset, the cursor doesn't move
+    Block neighbor(const glm::ivec3& offset) { return getBlockAt(pos + offset); }
+    bool isNeighborSolid(const glm::ivec3& offset) { return isBlockSolid(pos + offset); }
+    // Only if the chunk is loaded, like World::removeBlock
+    void set(BlockType type) { setBlockAt(pos, type); }
+
+    // Any position, same cache
+    Block getBlockAt(const glm::ivec3& worldPos) {
+        Chunk* chunk = chunkOf(worldPos);
+        return chunk ? chunk->getBlockAt(ChunkLayout::localOf(worldPos)) : Block{AIR};
+    }
+    bool isBlockSolid(const glm::ivec3& worldPos) {
+        Chunk* chunk = chunkOf(worldPos);
+        return chunk && chunk->isSolidAt(ChunkLayout::localOf(worldPos));
+    }
+    void setBlockAt(const glm::ivec3& worldPos, BlockType type) {
+        Chunk* chunk = chunkOf(worldPos);
+        if (!chunk) return;
+        glm::ivec3 localPos = ChunkLayout::localOf(worldPos);
+        chunk->setBlockAt(localPos, type);
+        world.remeshNeighboursOf(cachedPos, localPos);
+    }
+
+    // Chunk holding `worldPos`, nullptr if not loaded (also cached)
+    Chunk* chunkOf(const glm::ivec3& worldPos) {
+        glm::ivec3 chunkPos = ChunkLayout::chunkOf(worldPos);
+        if (!cached || chunkPos != cachedPos) {
+            cachedPos = chunkPos;
+            cachedChunk = world.getChunkAt(chunkPos);
+            cached = true;
+            lookups++;
+        }
+        return cachedChunk;
+    }
+
+    // Chunk lookups made so far (the rest hit the cache)
+    size_t getLookupCount() const { return lookups; }
+
+private:
+    World& world;
+    glm::ivec3 pos;
+    glm::ivec3 cachedPos{0};
+    Chunk* cachedChunk = nullptr;
+    bool cached = false;
+    size_t lookups = 0;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Extra state of a block beyond its type: a small value for things like an
+// orientation or a growth stage, and optional bytes for bigger data
+// (container content...). Payloads are limited to
+// BlockMetadata::MAX_PAYLOAD_SIZE bytes (64 KB - 1).
+struct BlockData {
+    uint32_t value = 0;
+    std::vector<uint8_t> payload;
+
+    bool operator==(const BlockData& o) const { return value == o.value && payload == o.payload; }
+};
+
+// Sparse side table of BlockData keyed by block index inside a chunk.
+// Entries are kept sorted by index, so a chunk without rich blocks pays for
+// an empty vector only, and lookups are a binary search.
+class BlockMetadata {
+public:
+    struct Entry {
+        uint32_t index;
+        BlockData data;
+    };
+
+    // Largest payload the file format can hold
+    static constexpr size_t MAX_PAYLOAD_SIZE = UINT16_MAX;
+
+    const BlockData* get(uint32_t index) const;
+    // Returns false (and changes nothing) if the payload is over MAX_PAYLOAD_SIZE
+    bool set(uint32_t index, BlockData data);
+    // Returns true if there was an entry
+    bool erase(uint32_t index);
+
+    bool empty() const { return entries.empty(); }
+    size_t size() const { return entries.size(); }
+    const std::vector<Entry>& getEntries() const { return entries; }
+
+    // Binary layout: count (uint32), then per entry index (uint32),
+    // value (uint32), payload size (uint16) and payload bytes
+    void write(std::ostream& out) const;
+    // Indices must be below `maxIndex`. Returns false on truncated or inconsistent data.
+    bool read(std::istream& in, uint32_t maxIndex);
+
+    size_t memoryUsage() const;
+
+private:
+    std::vector<Entry> entries;
+
+    std::vector<Entry>::iterator find(uint32_t index);
+    std::vector<Entry>::const_iterator find(uint32_t index) const;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include "Block.h"
+#include <array>
+#include <cstdint>
+
+enum Face {
+    FRONT = 0,
+    BACK = 1,
+    LEFT = 2,
+    RIGHT = 3,
+    TOP = 4,
+    BOTTOM = 5
+};
+
+// Tile of the texture atlas used by each face
+struct BlockTexture {
+    int front;
+    int back;
+    int left;
+    int right;
+    int top;
+    int bottom;
+};
+
+// When the faces of a non-opaque block are drawn
+// (opaque blocks always use CULL_OPAQUE)
+enum CullMode : uint8_t {
+    CULL_OPAQUE, // hidden by opaque neighbours
+    CULL_SAME,   // also hidden by a neighbour of the same type (glass, water)
+    CULL_NEVER,  // always drawn
+};
+
+struct BlockInfo {
+    const char* name = "air";
+    std::array<uint8_t, 6> tiles{}; // indexed by Face
+    bool opaque = false;            // hides the faces of its neighbours
+    bool solid = false;             // collides with the player, stops raycasts
+    CullMode cull = CULL_NEVER;
+    bool soil = false;              // trees can grow on it
+};
+
+constexpr BlockInfo opaqueBlock(const char* name, BlockTexture t, bool soil = false) {
+    BlockInfo info;
+    info.name = name;
+    info.tiles = {static_cast<uint8_t>(t.front), static_cast<uint8_t>(t.back),
+                  static_cast<uint8_t>(t.left), static_cast<uint8_t>(t.right),
+                  static_cast<uint8_t>(t.top), static_cast<uint8_t>(t.bottom)};
+    info.opaque = true;
+    info.solid = true;
+    info.cull = CULL_OPAQUE;
+    info.soil = soil;
+    return info;
+}
+
+// Properties of every block type, indexed by BlockType.
+// Block texture is {front, back, left, right, top, bottom}
+constexpr std::array<BlockInfo, BLOCK_TYPE_COUNT> makeBlockRegistry() {
+    std::array<BlockInfo, BLOCK_TYPE_COUNT> r{};
+    r[AIR]         = BlockInfo{};
+    r[DIRT]        = opaqueBlock("dirt", {0, 0, 0, 0, 0, 0}, true);
+    r[GRASS]       = opaqueBlock("grass", {1, 1, 1, 1, 2, 0}, true);
+    r[STONE]       = opaqueBlock("stone", {3, 3, 3, 3, 3, 3});
+    r[WOOD]        = opaqueBlock("wood", {6, 6, 6, 6, 7, 7});
+    r[LEAF]        = opaqueBlock("leaf", {5, 5, 5, 5, 5, 5});
+    r[SAND]        = opaqueBlock("sand", {4, 4, 4, 4, 4, 4});
+    r[PUMPKIN]     = opaqueBlock("pumpkin", {8, 9, 9, 9, 9, 10});
+    r[SNOW]        = opaqueBlock("snow", {11, 11, 11, 11, 11, 11});
+    r[COBBLESTONE] = opaqueBlock("cobblestone", {12, 12, 12, 12, 12, 12});
+    r[BRICK]       = opaqueBlock("brick", {13, 13, 13, 13, 13, 13});
+    r[PLANKS]      = opaqueBlock("planks", {14, 14, 14, 14, 14, 14});
+    r[IRON_ORE]    = opaqueBlock("iron ore", {15, 15, 15, 15, 15, 15});
+    return r;
+}
+
+inline constexpr std::array<BlockInfo, BLOCK_TYPE_COUNT> BLOCK_REGISTRY = makeBlockRegistry();
+
+constexpr const BlockInfo& blockInfo(BlockType type) { return BLOCK_REGISTRY[type]; }
+
+// The opaque masks of ChunkSection rely on this: a set bit means solid too
+constexpr bool opaqueBlocksAreSolid() {
+    for (const BlockInfo& info : BLOCK_REGISTRY) {
+        if (info.opaque && (!info.solid || info.cull != CULL_OPAQUE)) return false;
+    }
+    return true;
+}
+static_assert(opaqueBlocksAreSolid(), "opaque blocks must be solid and use CULL_OPAQUE");
+static_assert(!BLOCK_REGISTRY[AIR].opaque && !BLOCK_REGISTRY[AIR].solid, "air is empty");
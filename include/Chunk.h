@@ -3,50 +3,22 @@
 #include <vector>
 #include <glad/glad.h>
 #include "PerlinNoise.hpp"
+#include "Block.h"
+#include "BlockRegistry.h"
+#include "ChunkLayout.h"
+#include "ChunkSection.h"
+#include "BlockMetadata.h"
+#include <array>
 #include <atomic>
-
-enum BlockType {
-    AIR,
-    DIRT,
-    GRASS,
-    STONE,
-    WOOD,
-    LEAF,
-    SAND,
-    PUMPKIN,
-    SNOW,
-    COBBLESTONE,
-    BRICK,
-    PLANKS,
-    IRON_ORE
-};
-
-enum Face {
-    FRONT = 0,
-    BACK = 1,
-    LEFT = 2,
-    RIGHT = 3,
-    TOP = 4,
-    BOTTOM = 5
-};
+#include <mutex>
+#include <istream>
+#include <ostream>
+#include <memory>
 
 struct ChunkMeshGL {
     GLuint vao = 0, vbo = 0, ebo = 0;
     size_t indexCount = 0;
-};
-
-struct BlockTexture {
-    int front;
-    int back;
-    int left;
-    int right;
-    int top;
-    int bottom;
-};
-
-struct Block {
-    glm::ivec3 position;
-    BlockType type;
+    size_t bytes = 0; // vertex + index buffer storage
 };
 
 struct Vertex {
@@ -56,21 +28,61 @@ struct Vertex {
     glm::vec3 normal;
 };
 
+// One block to set, for the batched edits (Chunk::setBlocks, World::applyEdits).
+// The position is local to the chunk or in the world depending on who takes it.
+struct BlockEdit {
+    glm::ivec3 pos;
+    BlockType type;
+};
+
+struct BlockRef;
+class ChunkPool;
+class ChunkNeighborhood;
+struct ChunkSnapshot;
+
+// CPU side of a chunk mesh, from generateMesh until it is uploaded to the GPU.
+// Also holds the scratch of the mesher so that everything is recycled together.
+struct MeshBuffers {
+    std::vector<Vertex>   vertices;
+    std::vector<uint32_t> indices;
+
+    std::vector<glm::ivec3> positions;
+    std::vector<Face>       faces;
+    std::vector<BlockType>  types;
+
+    size_t accountedBytes = 0; // bookkeeping of the ChunkPool
+
+    size_t memoryUsage() const {
+        return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(uint32_t)
+             + positions.capacity() * sizeof(glm::ivec3) + faces.capacity() * sizeof(Face)
+             + types.capacity() * sizeof(BlockType);
+    }
+};
+
 class Chunk {
 public:
-    std::vector<Block> blocks;
-    bool meshGenerated = false;
+    static constexpr glm::ivec3 CHUNK_SIZE = glm::ivec3(ChunkLayout::SIZE_X, ChunkLayout::SIZE_Y, ChunkLayout::SIZE_Z);
+    static constexpr int SECTION_COUNT = ChunkLayout::SIZE_Y >> ChunkSection::SHIFT;
+
+    static_assert(ChunkLayout::SIZE_X == ChunkSection::SIZE && ChunkLayout::SIZE_Z == ChunkSection::SIZE,
+                  "a chunk is exactly one section wide");
+    static_assert(ChunkLayout::SIZE_Y % ChunkSection::SIZE == 0,
+                  "the chunk height must be a multiple of the section height");
+
+    std::atomic<bool> meshGenerated{false}; // a mesh has been built, the chunk can be drawn
     bool uploadingToGPU = false;
-    std::atomic<bool> busy{false};
+    std::atomic<bool> busy{false}; // pinned by a worker thread, see ChunkPool::pin
+    uint64_t lastVisibleFrame = 0; // World::frame when last in view, main thread only
+    // Trees of its surface planted (World::generateStructureInChunk), main thread only.
+    // Not saved: a chunk loaded back gets them planted again, like a new one.
+    bool structuresGenerated = false;
 
-    static const glm::ivec3 CHUNK_SIZE;
     glm::ivec3 chunkPos;
 
     ChunkMeshGL gl;
 
-    Chunk(const glm::ivec3& pos) : chunkPos(pos) {
-        blocks.resize(CHUNK_SIZE.x * CHUNK_SIZE.y * CHUNK_SIZE.z, {{0,0,0}, AIR});
-    }
+    Chunk(const glm::ivec3& pos)
+        : chunkPos(pos), sections(makeSections()) {}
 
     ~Chunk() {
         if (gl.vao != 0) {
@@ -78,36 +90,218 @@ public:
             glDeleteBuffers(1, &gl.vbo);
             glDeleteBuffers(1, &gl.ebo);
         }
-
-        blocks.clear();
-        vertices.clear();
-        indices.clear();
-        meshPositions.clear();
-        meshFaces.clear();
-        meshTypes.clear();
     }
 
     void generate(siv::PerlinNoise& perlin);
 
+    // Meshes the current snapshot, can run on any thread. Without a
+    // neighbourhood the faces on the border of the chunk are always drawn.
     void generateMesh();
-    Block& getBlockAt(const glm::ivec3& localPos);
+    // Hides the border faces covered by the neighbours (hood built from this chunk)
+    void generateMesh(const ChunkNeighborhood& hood);
+    // Edited, or a neighbour asked for it, since the last generateMesh started
+    bool needsMesh() const {
+        return meshedVersion.load() != version.load() || meshedRemeshRequests.load() != remeshRequests.load();
+    }
+    // A neighbour changed next to the border: remesh without touching the
+    // version, the blocks of this chunk are the same (nothing to save)
+    void requestRemesh() { remeshRequests++; }
+    uint64_t getRemeshRequests() const { return remeshRequests.load(); }
+
+    // Consistent read-only view of the blocks, for worker threads.
+    // Only takes the lock to copy the section pointers.
+    ChunkSnapshot snapshot() const;
+    // Bumped by every edit
+    uint64_t getVersion() const { return version.load(); }
+    // Edited since it was last saved or loaded
+    bool isDirty() const { return savedVersion.load() != version.load(); }
+
+    // Vertical 16^3 slices, from bottom to top.
+    // Main thread only: worker threads go through snapshot().
+    const ChunkSection& getSection(int s) const { return *sections[s]; }
+
+    Block getBlockAt(const glm::ivec3& localPos) const;
+    BlockRef getBlockRef(const glm::ivec3& localPos) const;
+    // Changing the type of a block drops its BlockData
     void setBlockAt(const glm::ivec3& localPos, BlockType type);
+
+    // Bulk edits: one lock and one version bump for the whole operation, the
+    // sections are filled a column range at a time (see ChunkSection::fillColumn).
+    // Block data of the blocks that change type is dropped, like setBlockAt.
+    // Box [min, max) in local coordinates, clamped to the chunk
+    void fillBox(const glm::ivec3& min, const glm::ivec3& max, BlockType type);
+    // Blocks [yBegin, yEnd) of a column
+    void fillColumn(int localX, int localZ, int yBegin, int yEnd, BlockType type) {
+        fillBox({localX, yBegin, localZ}, {localX + 1, yEnd, localZ + 1}, type);
+    }
+    // Every `from` block becomes `to`, returns how many changed
+    int replaceBlocks(BlockType from, BlockType to);
+    // Scattered blocks in local coordinates, applied in order (the last edit of a
+    // position wins). The mesher never sees half of the batch.
+    void setBlocks(const BlockEdit* edits, size_t count);
+
+    // Extra data of rich blocks, nullptr for plain ones
+    const BlockData* getBlockData(const glm::ivec3& localPos) const;
+    // False if the position is outside the chunk or the payload too big to be saved
+    bool setBlockData(const glm::ivec3& localPos, BlockData data);
+    void clearBlockData(const glm::ivec3& localPos);
+    // Whether the block collides, read from the opaque masks when possible
+    bool isSolidAt(const glm::ivec3& localPos) const {
+        if (!ChunkLayout::contains(localPos)) return false;
+        return sections[localPos.y >> ChunkSection::SHIFT]->isSolid(
+            localPos.x, localPos.y & ChunkSection::MASK, localPos.z);
+    }
     void uploadMeshToGPU();
 
+    // Number of blocks of a type, from the section histograms
+    int countBlocks(BlockType type) const {
+        int total = 0;
+        for (const auto& section : sections) total += section->count(type);
+        return total;
+    }
+    bool containsBlock(BlockType type) const {
+        for (const auto& section : sections) {
+            if (section->contains(type)) return true;
+        }
+        return false;
+    }
+
+    // Local y of the highest non-air block of a column, -1 if the column is empty
+    int getHighestBlockAt(int localX, int localZ) const {
+        return heightMap[localX + localZ * CHUNK_SIZE.x] - 1;
+    }
+    // Same, ignoring the blocks above maxLocalY
+    int getHighestBlockAt(int localX, int localZ, int maxLocalY) const;
+    // Range of local y holding non-air blocks (minY > maxY when the chunk is empty).
+    // maxY is exact, minY may be lower than the real lowest block after removals.
+    int getMinY() const { return minOccupiedY; }
+    int getMaxY() const { return maxOccupiedY; }
+
+    // Bytes used by the block storage of this chunk
+    size_t memoryUsage() const {
+        size_t total = 0;
+        for (const auto& section : sections) total += section->memoryUsage();
+        if (metadata) total += metadata->memoryUsage();
+        return total;
+    }
+    // Same, without the sections shared through the SectionCache, which
+    // accounts for them once
+    size_t ownedMemoryUsage() const {
+        size_t total = 0;
+        for (const auto& section : sections) {
+            if (section.use_count() == 1) total += section->memoryUsage();
+        }
+        if (metadata) total += metadata->memoryUsage();
+        return total;
+    }
+    // What unloading it gives back: its own sections, plus the cached ones
+    // that only this chunk still uses (freed by the next SectionCache::trim)
+    size_t releasableMemoryUsage() const;
+
+    // Blocks are numbered section by section (the chunk is as wide as a section)
+    static constexpr int indexOf(const glm::ivec3& localPos) {
+        return ((localPos.y >> ChunkSection::SHIFT) << (3 * ChunkSection::SHIFT))
+             | ChunkSection::indexOf(localPos.x, localPos.y & ChunkSection::MASK, localPos.z);
+    }
+    static constexpr glm::ivec3 localPosOf(int index) {
+        glm::ivec3 p = ChunkSection::localPosOf(index & (ChunkSection::VOLUME - 1));
+        p.y |= (index >> (3 * ChunkSection::SHIFT)) << ChunkSection::SHIFT;
+        return p;
+    }
+
+    // Compacts the sections then writes a snapshot, the chunk is clean afterwards
     void saveToFile(const std::string& filename);
     void loadFromFile(const std::string& filename);
     static bool isInFile(const std::string& filename);
+    // Same encoding as the files, without touching the dirty state
+    bool write(std::ostream& out);
+    bool read(std::istream& in);
+    // Writes bytes produced by write() as the file of a chunk
+    static bool saveEncoded(const std::string& filename, const std::string& data);
+    // Unsaved edits live somewhere else (see ChunkColdCache), save it on unload
+    void markDirty() { savedVersion = 0; }
 
 private:
-    std::vector<Vertex>   vertices;
-    std::vector<uint32_t> indices;
+    using SectionArray = std::array<std::shared_ptr<ChunkSection>, SECTION_COUNT>;
+
+    // Sections are shared with the snapshots and copied on write: a section is
+    // only modified in place while nothing else references it.
+    SectionArray sections;
+    // Guards `sections` and `heightMap` while the main thread edits them and
+    // snapshot() copies them, plus the `mesh` hand-off
+    mutable std::mutex blocksMutex;
+    // Copied on write like the sections, null while no block has data
+    std::shared_ptr<BlockMetadata> metadata;
+    std::atomic<uint64_t> version{1};
+    std::atomic<uint64_t> meshedVersion{0};
+    std::atomic<uint64_t> remeshRequests{0};
+    std::atomic<uint64_t> meshedRemeshRequests{0};
+    std::atomic<uint64_t> savedVersion{1};
+
+    // Section `s`, copied first if a snapshot still uses it. blocksMutex must be held.
+    ChunkSection& editSection(int s);
+    static SectionArray makeSections();
+    BlockMetadata& editMetadata();
+    // Swaps in freshly loaded sections and metadata, with the position read along
+    void installSections(const glm::ivec3& pos, SectionArray&& loaded,
+                         std::shared_ptr<BlockMetadata> loadedMetadata = nullptr);
+    ChunkSnapshot compactedSnapshot();
+
+    // 1 + local y of the highest non-air block of each column (x + z * 16), kept up to date by setBlockAt
+    std::array<int16_t, ChunkLayout::SIZE_X * ChunkLayout::SIZE_Z> heightMap{};
+    int minOccupiedY = CHUNK_SIZE.y;
+    int maxOccupiedY = -1;
 
-    std::vector<glm::ivec3> meshPositions; 
-    std::vector<Face>      meshFaces;
-    std::vector<BlockType> meshTypes;
+    void rebuildHeightMap();
+    // Top of one column from the section masks, -1 if empty
+    int findColumnTop(int localX, int localZ) const;
+    // Drops the block data matching `drop(localPos, type)`. blocksMutex must be held.
+    template <typename Predicate>
+    void eraseBlockDataIf(Predicate drop);
 
+    // Set when the chunk comes from a ChunkPool, mesh buffers are then borrowed from it
+    friend class ChunkPool;
+    ChunkPool* pool = nullptr;
+    void reset();
+
+    // Built by generateMesh, handed over under blocksMutex and released by uploadMeshToGPU
+    std::unique_ptr<MeshBuffers> mesh;
+    std::unique_ptr<MeshBuffers> acquireMesh();
+    void releaseMesh(std::unique_ptr<MeshBuffers> buffers);
+
+    void addNonOpaqueFaces(MeshBuffers& buffers, const ChunkNeighborhood& hood, int section);
     //void addFace(const glm::ivec3& bpos, Face f, int tileID);
-    void addFaces(const std::vector<glm::ivec3>& positions, 
-                  const std::vector<Face>& faces, 
-                  const std::vector<BlockType>& types);
+    void addFaces(MeshBuffers& buffers);
+};
+
+// Immutable view of the blocks of a chunk at one version. Holds its sections
+// alive, so it can be read from any thread while the chunk keeps changing.
+struct ChunkSnapshot {
+    uint64_t version = 0;
+    glm::ivec3 chunkPos{0};
+    std::array<std::shared_ptr<const ChunkSection>, Chunk::SECTION_COUNT> sections;
+    std::shared_ptr<const BlockMetadata> metadata; // may be null
+    std::array<int16_t, ChunkLayout::SIZE_X * ChunkLayout::SIZE_Z> heightMap{};
+    int minY = Chunk::CHUNK_SIZE.y;
+    int maxY = -1;
+
+    BlockType getBlockAt(const glm::ivec3& localPos) const {
+        if (!ChunkLayout::contains(localPos)) return AIR;
+        return sections[localPos.y >> ChunkSection::SHIFT]->get(
+            localPos.x, localPos.y & ChunkSection::MASK, localPos.z);
+    }
+
+    bool saveToFile(const std::string& filename) const;
+    bool write(std::ostream& out) const;
+};
+
+// Reference to a block inside a chunk. Blocks don't store their position,
+// it is recomputed from the storage index when asked for.
+struct BlockRef {
+    const Chunk* chunk;
+    int index;
+    BlockType type;
+
+    glm::ivec3 localPos() const { return Chunk::localPosOf(index); }
+    glm::ivec3 worldPos() const { return chunk->chunkPos * Chunk::CHUNK_SIZE + localPos(); }
 };
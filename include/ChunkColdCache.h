@@ -0,0 +1,57 @@
+#pragma once
+#include "ChunkLayout.h"
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// Second tier between loaded chunks and the disk: recently unloaded chunks
+// kept in RAM as encoded blobs (same bytes as the chunk files, so uniform and
+// palette sections stay a few bytes each). Walking back into an area is then
+// a decode instead of a file round trip.
+//
+// Entries leave least recently unloaded first once the cache is over capacity.
+// A chunk unloaded with unsaved edits is only written to disk at that point
+// (write-back), see World::unloadChunk. Main thread only.
+class ChunkColdCache {
+public:
+    struct Entry {
+        glm::ivec3 pos{0};
+        std::string blob;
+        bool dirty = false; // newer than the file on disk
+    };
+
+    struct Stats {
+        size_t puts = 0;
+        size_t hits = 0;       // take() that found the chunk
+        size_t misses = 0;
+        size_t evictions = 0;  // entries pushed out by newer ones
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    explicit ChunkColdCache(size_t capacityBytes) : capacity(capacityBytes) {}
+
+    // Replaces any older entry of the same chunk
+    void put(const glm::ivec3& pos, std::string blob, bool dirty);
+    // Moves the entry of `pos` out of the cache
+    bool take(const glm::ivec3& pos, Entry& out);
+
+    // Oldest entry, while the cache is over capacity
+    bool popOverflow(Entry& out);
+    // Oldest entry, whatever the size (to flush everything)
+    bool popOldest(Entry& out);
+
+    size_t getCapacity() const { return capacity; }
+    void setCapacity(size_t capacityBytes) { capacity = capacityBytes; }
+    Stats getStats() const;
+
+private:
+    size_t capacity;
+    size_t totalBytes = 0;
+    std::list<Entry> entries; // most recent first
+    std::unordered_map<glm::ivec3, std::list<Entry>::iterator, IVec3Hash> index;
+    Stats stats;
+
+    void removeEntry(std::list<Entry>::iterator it, Entry& out);
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// Chunk height in blocks, can be overridden from CMake (-DCHUNK_HEIGHT=64).
+// Chunks are stacked along y (chunkPos.y), so the height of the world doesn't
+// depend on it: 16 gives cubic chunks loaded by 3D distance from the player.
+#ifndef CHUNK_HEIGHT
+#define CHUNK_HEIGHT 16
+#endif
+
+constexpr bool isPowerOfTwo(int v) { return v > 0 && (v & (v - 1)) == 0; }
+constexpr int log2i(int v) { return v <= 1 ? 0 : 1 + log2i(v >> 1); }
+
+// Compile-time chunk dimensions.
+// Every size is a power of two so index math and world <-> chunk conversions
+// fold into shifts and masks.
+template <int SX, int SY, int SZ>
+struct BasicChunkLayout {
+    static_assert(isPowerOfTwo(SX) && isPowerOfTwo(SY) && isPowerOfTwo(SZ),
+                  "chunk dimensions must be powers of two");
+
+    static constexpr int SIZE_X = SX;
+    static constexpr int SIZE_Y = SY;
+    static constexpr int SIZE_Z = SZ;
+    static constexpr int VOLUME = SX * SY * SZ;
+
+    static constexpr int SHIFT_X = log2i(SX);
+    static constexpr int SHIFT_Y = log2i(SY);
+    static constexpr int SHIFT_Z = log2i(SZ);
+
+    static constexpr int MASK_X = SX - 1;
+    static constexpr int MASK_Y = SY - 1;
+    static constexpr int MASK_Z = SZ - 1;
+
+    static constexpr bool contains(const glm::ivec3& localPos) {
+        return static_cast<unsigned>(localPos.x) < static_cast<unsigned>(SX)
+            && static_cast<unsigned>(localPos.y) < static_cast<unsigned>(SY)
+            && static_cast<unsigned>(localPos.z) < static_cast<unsigned>(SZ);
+    }
+
+    // Floor division by the chunk size (>> on negative ints is arithmetic on every compiler we target)
+    static constexpr glm::ivec3 chunkOf(const glm::ivec3& worldPos) {
+        return glm::ivec3(worldPos.x >> SHIFT_X, worldPos.y >> SHIFT_Y, worldPos.z >> SHIFT_Z);
+    }
+    static constexpr glm::ivec3 localOf(const glm::ivec3& worldPos) {
+        return glm::ivec3(worldPos.x & MASK_X, worldPos.y & MASK_Y, worldPos.z & MASK_Z);
+    }
+    static constexpr glm::ivec3 origin(const glm::ivec3& chunkPos) {
+        return glm::ivec3(chunkPos.x << SHIFT_X, chunkPos.y << SHIFT_Y, chunkPos.z << SHIFT_Z);
+    }
+};
+
+using ChunkLayout = BasicChunkLayout<16, CHUNK_HEIGHT, 16>;
+
+// Key hash for maps of chunk positions. The coordinates are packed (21 bits
+// each, plenty for chunk positions) and mixed with the splitmix64 finalizer:
+// neighbouring positions land far apart and every bit of the result depends
+// on all three, so the low bits alone make a good bucket index.
+struct IVec3Hash {
+    size_t operator()(const glm::ivec3& v) const {
+        uint64_t h = (static_cast<uint64_t>(v.x) & 0x1FFFFF)
+                   | (static_cast<uint64_t>(v.y) & 0x1FFFFF) << 21
+                   | (static_cast<uint64_t>(v.z) & 0x1FFFFF) << 42;
+        h ^= h >> 30;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 27;
+        h *= 0x94D049BB133111EBull;
+        h ^= h >> 31;
+        return static_cast<size_t>(h);
+    }
+};
+
+// Order of the blocks inside a 16^3 section (4 bits per coordinate).
+// The id is written in chunk files so data saved with another order can be read back.
+enum BlockOrderId : uint8_t {
+    ORDER_XYZ = 0,      // x innermost (order of the first section files)
+    ORDER_YZX = 1,      // y innermost: a column is contiguous
+    ORDER_MORTON = 2    // Z-order curve, y bit first
+};
+
+struct XYZOrder {
+    static constexpr BlockOrderId ID = ORDER_XYZ;
+    static constexpr int index(int x, int y, int z) { return x | (y << 4) | (z << 8); }
+    static constexpr glm::ivec3 position(int i) { return glm::ivec3(i & 15, (i >> 4) & 15, (i >> 8) & 15); }
+};
+
+struct YZXOrder {
+    static constexpr BlockOrderId ID = ORDER_YZX;
+    static constexpr int index(int x, int y, int z) { return y | (z << 4) | (x << 8); }
+    static constexpr glm::ivec3 position(int i) { return glm::ivec3((i >> 8) & 15, i & 15, (i >> 4) & 15); }
+};
+
+struct MortonOrder {
+    static constexpr BlockOrderId ID = ORDER_MORTON;
+
+    // abcd -> a..b..c..d
+    static constexpr int spread(int v) {
+        return (v & 1) | ((v & 2) << 2) | ((v & 4) << 4) | ((v & 8) << 6);
+    }
+    static constexpr int compact(int v) {
+        return (v & 1) | ((v >> 2) & 2) | ((v >> 4) & 4) | ((v >> 6) & 8);
+    }
+
+    static constexpr int index(int x, int y, int z) { return spread(y) | (spread(z) << 1) | (spread(x) << 2); }
+    static constexpr glm::ivec3 position(int i) { return glm::ivec3(compact(i >> 2), compact(i), compact(i >> 1)); }
+};
+
+// Selected from CMake with -DCHUNK_BLOCK_ORDER=MORTON
+#ifdef CHUNK_ORDER_MORTON
+using SectionOrder = MortonOrder;
+#else
+using SectionOrder = YZXOrder;
+#endif
+
+inline int sectionIndex(BlockOrderId order, int x, int y, int z) {
+    switch (order) {
+        case ORDER_XYZ:    return XYZOrder::index(x, y, z);
+        case ORDER_MORTON: return MortonOrder::index(x, y, z);
+        case ORDER_YZX:
+        default:           return YZXOrder::index(x, y, z);
+    }
+}
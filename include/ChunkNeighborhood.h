@@ -0,0 +1,74 @@
+#pragma once
+#include "Chunk.h"
+#include <array>
+#include <vector>
+
+// Read-only copy of a chunk with a one block border taken from its 26
+// neighbours (chunks are stacked vertically, so the ones above and below
+// count too). Reads go from -1 to SIZE on every axis with no bounds check and
+// no map lookup, so the mesher (and later lighting or fluids) can look past
+// the edges of the chunk. Missing neighbours read as air.
+//
+// build() snapshots the chunks and copies what it needs, so nothing stays
+// pinned afterwards and edits don't have to copy sections because of it.
+// Meant to be reused: the buffers keep their size from one build to the next.
+class ChunkNeighborhood {
+public:
+    static constexpr int PAD_X = ChunkLayout::SIZE_X + 2;
+    static constexpr int PAD_Y = ChunkLayout::SIZE_Y + 2;
+    static constexpr int PAD_Z = ChunkLayout::SIZE_Z + 2;
+    static constexpr int VOLUME = PAD_X * PAD_Y * PAD_Z;
+
+    // Neighbours are numbered (dx + 1) + (dz + 1) * 3 + (dy + 1) * 9
+    static constexpr int COUNT = 27;
+    static constexpr int CENTER = 13;
+    static constexpr glm::ivec3 offsetOf(int i) { return glm::ivec3(i % 3 - 1, i / 9 - 1, (i / 3) % 3 - 1); }
+    static constexpr int indexOfOffset(const glm::ivec3& d) { return (d.x + 1) + (d.z + 1) * 3 + (d.y + 1) * 9; }
+
+    using Neighbors = std::array<const Chunk*, COUNT>;
+
+    // neighbors[CENTER] is ignored, null entries are chunks not loaded
+    void build(const Chunk& center, const Neighbors& neighbors);
+
+    // State of the center chunk when it was snapshotted
+    const glm::ivec3& getChunkPos() const { return chunkPos; }
+    uint64_t getVersion() const { return version; }
+    // Remesh requests of the center chunk, see Chunk::requestRemesh
+    uint64_t getRemeshStamp() const { return remeshStamp; }
+    // Occupied range of local y, see Chunk::getMinY
+    int getMinY() const { return minY; }
+    int getMaxY() const { return maxY; }
+    bool isSectionEmpty(int s) const { return sectionEmpty[s]; }
+    bool hasNonOpaqueBlocks(int s) const { return sectionNonOpaque[s]; }
+    bool hasNeighbor(int i) const { return present[i]; }
+
+    // x and z in [-1, SIZE_X/Z], y in [-1, SIZE_Y]
+    BlockType get(int x, int y, int z) const { return types[paddedIndex(x, y, z)]; }
+    BlockType get(const glm::ivec3& localPos) const { return get(localPos.x, localPos.y, localPos.z); }
+    bool isOpaque(int x, int y, int z) const { return blockInfo(get(x, y, z)).opaque; }
+
+    // Opaque bits of the 16 blocks of section `s` in column (x, z), with x and z in [-1, 16]
+    ChunkSection::ColumnMask opaqueColumn(int s, int x, int z) const {
+        return columns[(x + 1) + (z + 1) * PAD_X + s * PAD_X * PAD_Z];
+    }
+
+    // Columns of y are contiguous, like the YZX section order
+    static constexpr int paddedIndex(int x, int y, int z) { return (y + 1) + PAD_Y * ((z + 1) + PAD_Z * (x + 1)); }
+
+private:
+    glm::ivec3 chunkPos{0};
+    uint64_t version = 0;
+    uint64_t remeshStamp = 0;
+    int minY = 0, maxY = -1;
+    std::array<bool, Chunk::SECTION_COUNT> sectionEmpty{};
+    std::array<bool, Chunk::SECTION_COUNT> sectionNonOpaque{};
+    std::array<bool, COUNT> present{};
+    std::vector<BlockType> types;
+    std::vector<ChunkSection::ColumnMask> columns;
+
+    void copyCenter(const ChunkSnapshot& center);
+    // Copies the part of the border facing neighbour `i`, air if it is null
+    void copyBorder(int i, const ChunkSnapshot* neighbor);
+    // Opaque masks of the border columns, from the copied types
+    void buildBorderColumns();
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include "Chunk.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Reference to a chunk of a ChunkPool: slot index + generation of the slot.
+// The generation changes when the chunk is released, so a handle kept by a
+// worker after an unload is detected instead of pointing to another chunk.
+struct ChunkHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0; // odd while the chunk is in use
+
+    bool operator==(const ChunkHandle& o) const { return index == o.index && generation == o.generation; }
+    bool operator!=(const ChunkHandle& o) const { return !(*this == o); }
+};
+
+// Owns every Chunk and recycles them (with their GL buffers) along with the
+// mesh buffers, instead of going through the allocator every time a chunk is
+// loaded, meshed or unloaded.
+//
+// Slots are never freed, so a Chunk* stays a valid object for the lifetime of
+// the pool. acquire/release are for the main thread; worker threads go
+// through pin/unpin, which keeps a chunk from being recycled while in use.
+class ChunkPool {
+public:
+    static constexpr uint32_t PAGE_SIZE = 1024;
+    static constexpr uint32_t MAX_PAGES = 256;
+
+    struct Stats {
+        size_t chunkRequests = 0;
+        size_t chunkHits = 0;         // requests served by a recycled slot
+        size_t chunksAllocated = 0;   // Chunk objects created so far
+        size_t chunksFree = 0;
+        size_t pendingReleases = 0;   // released while pinned by a worker
+        size_t meshRequests = 0;
+        size_t meshHits = 0;
+        size_t meshBuffersAllocated = 0;
+        size_t meshBufferBytes = 0;   // CPU mesh buffers, in use or free
+        size_t footprintBytes = 0;    // chunk objects + mesh buffers owned by the pool
+        size_t peakFootprintBytes = 0;
+    };
+
+    ChunkPool() = default;
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+
+    // Blank chunk (all air, no mesh) at `pos`. Invalid handle if the pool is full.
+    ChunkHandle acquire(const glm::ivec3& pos);
+    // Invalidates every handle to the chunk, which goes back to the pool
+    void release(ChunkHandle handle);
+
+    bool isValid(ChunkHandle handle) const {
+        if (handle.index >= slotsUsed.load(std::memory_order_acquire) || !(handle.generation & 1)) return false;
+        return slotAt(handle.index).generation.load(std::memory_order_acquire) == handle.generation;
+    }
+    // nullptr if the handle is stale
+    Chunk* get(ChunkHandle handle) const {
+        return isValid(handle) ? slotAt(handle.index).chunk.get() : nullptr;
+    }
+
+    // For worker threads: like get(), but the chunk can't be recycled until unpin()
+    Chunk* pin(ChunkHandle handle);
+    void unpin(Chunk* chunk) { chunk->busy = false; }
+
+    std::unique_ptr<MeshBuffers> acquireMesh();
+    void releaseMesh(std::unique_ptr<MeshBuffers> buffers);
+    // Frees the mesh buffers not in use, returns how many bytes that was
+    size_t trimMeshes();
+
+    Stats getStats() const;
+    void printStats() const;
+
+private:
+    struct Slot {
+        std::unique_ptr<Chunk> chunk;
+        std::atomic<uint32_t> generation{0};
+    };
+
+    // Fixed page table so that slots never move while workers read them
+    std::array<std::unique_ptr<Slot[]>, MAX_PAGES> pages;
+    std::atomic<uint32_t> slotsUsed{0};
+
+    Slot& slotAt(uint32_t index) const { return pages[index / PAGE_SIZE][index % PAGE_SIZE]; }
+
+    mutable std::mutex mutex;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> pendingSlots; // released while pinned, recycled once unpinned
+    std::vector<std::unique_ptr<MeshBuffers>> freeMeshes;
+    Stats stats;
+    size_t meshBytes = 0;
+
+    void recyclePending();
+    void updateFootprint();
+};
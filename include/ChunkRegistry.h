@@ -0,0 +1,36 @@
+#pragma once
+#include "ChunkPool.h"
+#include "FlatChunkMap.h"
+#include <atomic>
+#include <memory>
+
+// Read side of World::chunkMap for the other threads, RCU style: the main
+// thread keeps editing its own map and publishes an immutable copy of it
+// (at most once per frame). A reader loads the current copy with one atomic
+// pointer load and keeps it as long as it likes: lookups and iteration in it
+// take no lock and never see a half-done insert or erase.
+//
+// A copy may list chunks unloaded since it was published. Their handles are
+// stale, so ChunkPool::pin returns nullptr for them.
+class ChunkRegistry {
+public:
+    using Map = FlatChunkMap<ChunkHandle>;
+    using Snapshot = std::shared_ptr<const Map>;
+
+    ChunkRegistry();
+    ChunkRegistry(const ChunkRegistry&) = delete;
+    ChunkRegistry& operator=(const ChunkRegistry&) = delete;
+
+    // Main thread. Never waits for the readers: the old copy is freed by
+    // whoever drops it last, or reused by a later publish once nobody holds it.
+    void publish(const Map& map);
+
+    // Any thread
+    Snapshot acquire() const { return std::atomic_load_explicit(&current, std::memory_order_acquire); }
+
+private:
+    Snapshot current;
+    // Previously published copy, its storage is reused when no reader has it anymore
+    std::shared_ptr<Map> spare;
+    std::shared_ptr<Map> published; // same object as `current`, writable for the main thread
+};
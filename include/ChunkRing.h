@@ -0,0 +1,172 @@
+#pragma once
+#include "ChunkLayout.h"
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+
+// Box of chunk positions around a center (the player), stored as a 3D
+// toroidal array: position p lives in slot (p mod N) on each axis, N being a
+// power of two at least as large as the box. Each slot also keeps its
+// position, so a lookup is a few masks and one compare, no hashing or
+// probing.
+//
+// When the center moves, the slots of the positions leaving the box are
+// the ones reused by the entering positions. recenter() only visits the
+// slabs that left instead of every loaded chunk. Main thread only.
+template <typename V>
+class ChunkRing {
+public:
+    ChunkRing() = default;
+
+    // Empties the ring and sets a window of center +- radius (horizontal) and
+    // +- verticalRadius. A negative radius makes the window empty.
+    void reset(const glm::ivec3& newCenter, int radius, int verticalRadius) {
+        center = newCenter;
+        horizontalRadius = radius;
+        this->verticalRadius = verticalRadius;
+        shiftXZ = log2i(slotsFor(radius));
+        shiftY = log2i(slotsFor(verticalRadius));
+        maskXZ = (1 << shiftXZ) - 1;
+        maskY = (1 << shiftY) - 1;
+        slots.assign(radius < 0 || verticalRadius < 0 ? 0 : size_t(1) << (2 * shiftXZ + shiftY), Slot());
+        count = 0;
+    }
+
+    const glm::ivec3& getCenter() const { return center; }
+    int getRadius() const { return horizontalRadius; }
+    int getVerticalRadius() const { return verticalRadius; }
+    size_t size() const { return count; }
+
+    bool inWindow(const glm::ivec3& pos) const {
+        glm::ivec3 d = pos - center;
+        return std::abs(d.x) <= horizontalRadius && std::abs(d.z) <= horizontalRadius && std::abs(d.y) <= verticalRadius;
+    }
+
+    // nullptr if nothing is stored at `pos` (absent or outside the window)
+    V* get(const glm::ivec3& pos) {
+        if (slots.empty()) return nullptr;
+        Slot& slot = slots[slotOf(pos)];
+        return slot.pos == pos ? &slot.value : nullptr;
+    }
+    const V* get(const glm::ivec3& pos) const { return const_cast<ChunkRing*>(this)->get(pos); }
+
+    // False if `pos` is outside the window
+    bool set(const glm::ivec3& pos, const V& value) {
+        if (!inWindow(pos)) return false;
+        Slot& slot = slots[slotOf(pos)];
+        if (slot.pos != pos) {
+            slot.pos = pos;
+            count++;
+        }
+        slot.value = value;
+        return true;
+    }
+
+    bool erase(const glm::ivec3& pos) {
+        if (slots.empty()) return false;
+        Slot& slot = slots[slotOf(pos)];
+        if (slot.pos != pos) return false;
+        slot = Slot();
+        count--;
+        return true;
+    }
+
+    // Moves the window to `newCenter`. The entries that end up outside are
+    // removed and passed to onLeave(pos, value), only the slabs between the
+    // two windows are visited.
+    template <typename F>
+    void recenter(const glm::ivec3& newCenter, F&& onLeave) {
+        if (newCenter == center) return;
+        Box before = window();
+        center = newCenter;
+        Box after = window();
+        if (slots.empty()) return;
+
+        // Too far to overlap, everything leaves
+        if (!before.overlaps(after)) {
+            for (Slot& slot : slots) {
+                if (slot.pos.x == EMPTY || inWindow(slot.pos)) continue;
+                leave(slot, onLeave);
+            }
+            return;
+        }
+
+        // before \ after, as up to 6 disjoint slabs: x first, then y, then z
+        Box rest = before;
+        for (int axis = 0; axis < 3; axis++) {
+            if (rest.min[axis] < after.min[axis]) {
+                Box slab = rest;
+                slab.max[axis] = after.min[axis] - 1;
+                sweep(slab, onLeave);
+                rest.min[axis] = after.min[axis];
+            }
+            if (rest.max[axis] > after.max[axis]) {
+                Box slab = rest;
+                slab.min[axis] = after.max[axis] + 1;
+                sweep(slab, onLeave);
+                rest.max[axis] = after.max[axis];
+            }
+        }
+    }
+
+private:
+    static constexpr int EMPTY = INT_MIN; // pos.x of a free slot
+
+    struct Slot {
+        glm::ivec3 pos{EMPTY, EMPTY, EMPTY};
+        V value{};
+    };
+
+    // Inclusive bounds
+    struct Box {
+        glm::ivec3 min, max;
+        bool overlaps(const Box& o) const {
+            return min.x <= o.max.x && o.min.x <= max.x && min.y <= o.max.y && o.min.y <= max.y
+                && min.z <= o.max.z && o.min.z <= max.z;
+        }
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    glm::ivec3 center{0};
+    int horizontalRadius = -1;
+    int verticalRadius = -1;
+    int shiftXZ = 0, shiftY = 0;
+    int maskXZ = 0, maskY = 0;
+
+    // Slots per axis for a window of +-radius
+    static int slotsFor(int radius) {
+        int n = 1;
+        while (n < 2 * radius + 1) n *= 2;
+        return n;
+    }
+
+    size_t slotOf(const glm::ivec3& pos) const {
+        return size_t(pos.x & maskXZ) | size_t(pos.z & maskXZ) << shiftXZ | size_t(pos.y & maskY) << (2 * shiftXZ);
+    }
+
+    Box window() const {
+        glm::ivec3 r(horizontalRadius, verticalRadius, horizontalRadius);
+        return {center - r, center + r};
+    }
+
+    template <typename F>
+    void leave(Slot& slot, F& onLeave) {
+        Slot old = slot;
+        slot = Slot();
+        count--;
+        onLeave(old.pos, old.value);
+    }
+
+    template <typename F>
+    void sweep(const Box& box, F& onLeave) {
+        for (int y = box.min.y; y <= box.max.y; y++)
+            for (int z = box.min.z; z <= box.max.z; z++)
+                for (int x = box.min.x; x <= box.max.x; x++) {
+                    glm::ivec3 pos(x, y, z);
+                    Slot& slot = slots[slotOf(pos)];
+                    if (slot.pos == pos) leave(slot, onLeave);
+                }
+    }
+};
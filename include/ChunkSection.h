@@ -0,0 +1,236 @@
+#pragma once
+#include "PaletteStorage.h"
+#include "ChunkLayout.h"
+#include "BlockRegistry.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest / highest set bit, `mask` must not be 0
+inline int lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return static_cast<int>(i);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+inline int highestBit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse(&i, mask);
+    return static_cast<int>(i);
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+// 16x16x16 vertical slice of a chunk.
+// A section filled with a single type (all air, all stone...) is stored as that
+// one value, see PaletteStorage.
+//
+// Next to the palette we keep one 16 bit word per (x, z) column with bit y set
+// when the block is opaque, so neighbour tests are shifts and ands instead of
+// palette decodes. Uniform sections don't need it (all 0 or all 1).
+// Non-opaque blocks other than air (none yet) are not in the masks, sections
+// holding some are flagged so callers can look at them one by one.
+// A per-type block count is kept as well, answering "is it empty", "does it
+// contain iron ore" or "is the palette compact" without touching the blocks.
+class ChunkSection {
+public:
+    static constexpr int SHIFT = 4;
+    static constexpr int SIZE = 1 << SHIFT;
+    static constexpr int MASK = SIZE - 1;
+    static constexpr int VOLUME = SIZE * SIZE * SIZE;
+    static constexpr int COLUMNS = SIZE * SIZE;
+
+    using ColumnMask = uint16_t;
+    static constexpr ColumnMask FULL_COLUMN = 0xFFFF;
+
+    ChunkSection(BlockType fill = AIR) : blocks(VOLUME, fill) {
+        typeCounts[fill] = VOLUME;
+    }
+
+    static_assert(SIZE == 16, "block orders work on 4 bits per coordinate");
+    static_assert(sizeof(ColumnMask) * 8 == SIZE, "one bit per block of a column");
+    static_assert(VOLUME <= UINT16_MAX, "type counts are 16 bits");
+
+    static constexpr int indexOf(int x, int y, int z) {
+        return SectionOrder::index(x, y, z);
+    }
+    static constexpr glm::ivec3 localPosOf(int index) {
+        return SectionOrder::position(index);
+    }
+    static constexpr int columnOf(int x, int z) { return x + (z << SHIFT); }
+
+    const PaletteStorage& storage() const { return blocks; }
+
+    BlockType get(int index) const { return blocks.get(index); }
+    BlockType get(int x, int y, int z) const { return blocks.get(indexOf(x, y, z)); }
+
+    void set(int x, int y, int z, BlockType type) {
+        int index = indexOf(x, y, z);
+        BlockType previous = blocks.get(index);
+        if (previous == type) return;
+        typeCounts[previous]--;
+        typeCounts[type]++;
+
+        bool wasOpaque = isUniform() && blockInfo(uniformType()).opaque;
+        blocks.set(index, type);
+        if (type != AIR && !blockInfo(type).opaque) nonOpaqueBlocks = true;
+        if (isUniform()) return; // still one type, masks are implicit
+
+        if (opaqueColumns.empty()) {
+            opaqueColumns.assign(COLUMNS, wasOpaque ? FULL_COLUMN : 0);
+        }
+        ColumnMask bit = static_cast<ColumnMask>(1u << y);
+        ColumnMask& column = opaqueColumns[columnOf(x, z)];
+        if (blockInfo(type).opaque) column |= bit;
+        else column &= static_cast<ColumnMask>(~bit);
+    }
+    void set(int index, BlockType type) {
+        glm::ivec3 p = localPosOf(index);
+        set(p.x, p.y, p.z, type);
+    }
+
+    // Bulk edits, see PaletteStorage::fill/replace.
+    // Blocks [y0, y1) of a column. Contiguous in the YZX order, other orders
+    // fall back to one set() per block.
+    void fillColumn(int x, int z, int y0, int y1, BlockType type) {
+        if (y0 >= y1) return;
+        if (SectionOrder::ID != ORDER_YZX) {
+            for (int y = y0; y < y1; y++) set(x, y, z, type);
+            return;
+        }
+        const size_t begin = indexOf(x, y0, z);
+        const size_t end = begin + (y1 - y0);
+        if (blocks.count(type, begin, end) == end - begin) return;
+
+        for (BlockType old : blocks.getPalette()) {
+            if (typeCounts[old]) typeCounts[old] -= static_cast<uint16_t>(blocks.count(old, begin, end));
+        }
+        typeCounts[type] += static_cast<uint16_t>(end - begin);
+
+        bool wasOpaque = isUniform() && blockInfo(uniformType()).opaque;
+        blocks.fill(begin, end, type);
+        if (type != AIR && !blockInfo(type).opaque) nonOpaqueBlocks = true;
+        if (isUniform()) return;
+
+        if (opaqueColumns.empty()) {
+            opaqueColumns.assign(COLUMNS, wasOpaque ? FULL_COLUMN : 0);
+        }
+        ColumnMask range = static_cast<ColumnMask>(((1u << (y1 - y0)) - 1) << y0);
+        ColumnMask& column = opaqueColumns[columnOf(x, z)];
+        if (blockInfo(type).opaque) column |= range;
+        else column &= static_cast<ColumnMask>(~range);
+    }
+    // Blocks of the box [min, max) in section coordinates
+    void fillBox(const glm::ivec3& min, const glm::ivec3& max, BlockType type) {
+        if (min == glm::ivec3(0) && max == glm::ivec3(SIZE)) {
+            *this = ChunkSection(type);
+            return;
+        }
+        for (int z = min.z; z < max.z; z++) {
+            for (int x = min.x; x < max.x; x++) fillColumn(x, z, min.y, max.y, type);
+        }
+    }
+    void replace(BlockType from, BlockType to) {
+        if (from == to || !contains(from)) return;
+        blocks.replace(from, to);
+        if (blockInfo(from).opaque != blockInfo(to).opaque) {
+            rebuildMasks(); // recounts as well
+            return;
+        }
+        typeCounts[to] += typeCounts[from];
+        typeCounts[from] = 0;
+        updateNonOpaqueFlag();
+    }
+    bool sameContent(const ChunkSection& other) const { return blocks.sameContent(other.blocks); }
+
+    // Replaces the whole content (file loading)
+    void assign(PaletteStorage&& stored) {
+        blocks = std::move(stored);
+        rebuildMasks();
+    }
+
+    ColumnMask opaqueColumn(int x, int z) const {
+        if (opaqueColumns.empty()) return blockInfo(uniformType()).opaque ? FULL_COLUMN : 0;
+        return opaqueColumns[columnOf(x, z)];
+    }
+    bool isOpaque(int x, int y, int z) const { return (opaqueColumn(x, z) >> y) & 1; }
+    bool isSolid(int x, int y, int z) const {
+        if (isOpaque(x, y, z)) return true;
+        return nonOpaqueBlocks && blockInfo(get(x, y, z)).solid;
+    }
+    // Bit y set for every non-air block of the column
+    ColumnMask occupiedColumn(int x, int z) const {
+        ColumnMask column = opaqueColumn(x, z);
+        if (!nonOpaqueBlocks) return column;
+        for (int y = 0; y < SIZE; y++) {
+            if (get(x, y, z) != AIR) column |= static_cast<ColumnMask>(1u << y);
+        }
+        return column;
+    }
+    // Whether blocks that are neither air nor opaque may be in the section
+    bool hasNonOpaqueBlocks() const { return nonOpaqueBlocks; }
+
+    bool isUniform() const { return blocks.isUniform(); }
+    BlockType uniformType() const { return blocks.getPalette()[0]; }
+    // All air, compacted or not
+    bool isEmpty() const { return typeCounts[AIR] == VOLUME; }
+
+    int count(BlockType type) const { return typeCounts[type]; }
+    bool contains(BlockType type) const { return typeCounts[type] != 0; }
+    int nonAirCount() const { return VOLUME - typeCounts[AIR]; }
+
+    void compact() {
+        // Nothing to drop when every palette entry is still in use
+        size_t typesUsed = 0;
+        for (uint16_t n : typeCounts) typesUsed += n != 0;
+        if (typesUsed == blocks.getPalette().size()) return;
+
+        blocks.compact();
+        if (isUniform()) {
+            opaqueColumns.clear();
+            opaqueColumns.shrink_to_fit();
+        }
+        updateNonOpaqueFlag();
+    }
+    size_t memoryUsage() const {
+        return blocks.memoryUsage() + opaqueColumns.capacity() * sizeof(ColumnMask);
+    }
+
+private:
+    PaletteStorage blocks;
+    std::vector<ColumnMask> opaqueColumns; // empty while the section is uniform
+    bool nonOpaqueBlocks = false;
+    std::array<uint16_t, BLOCK_TYPE_COUNT> typeCounts{};
+
+    void updateNonOpaqueFlag() {
+        nonOpaqueBlocks = false;
+        for (int type = 1; type < BLOCK_TYPE_COUNT; type++) {
+            if (typeCounts[type] && !BLOCK_REGISTRY[type].opaque) nonOpaqueBlocks = true;
+        }
+    }
+
+    void rebuildMasks() {
+        typeCounts.fill(0);
+        opaqueColumns.clear();
+        if (isUniform()) {
+            typeCounts[uniformType()] = VOLUME;
+            updateNonOpaqueFlag();
+            return;
+        }
+        opaqueColumns.assign(COLUMNS, 0);
+        for (int i = 0; i < VOLUME; i++) {
+            BlockType type = blocks.get(i);
+            typeCounts[type]++;
+            if (!blockInfo(type).opaque) continue;
+            glm::ivec3 p = localPosOf(i);
+            opaqueColumns[columnOf(p.x, p.z)] |= static_cast<ColumnMask>(1u << p.y);
+        }
+        updateNonOpaqueFlag();
+    }
+};
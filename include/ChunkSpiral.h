@@ -0,0 +1,62 @@
+#pragma once
+#include "ChunkLayout.h"
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+// Offsets of the chunks within `viewDistance` chunks horizontally (a disc)
+// and `verticalDistance` chunks vertically of a center, sorted nearest first
+// (distance in blocks between the chunk origins). Built once per pair of
+// distances: walking the chunks around the player is then a pointer bump
+// per chunk, with no allocation and no distance test, and whatever is done
+// in that order (drawing, generation) starts next to the player.
+class ChunkSpiral {
+public:
+    ChunkSpiral(int viewDistance, int verticalDistance);
+
+    // Yields center + offset, by value
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = glm::ivec3;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const glm::ivec3*;
+        using reference = glm::ivec3;
+
+        Iterator(const glm::ivec3* offset, const glm::ivec3& center) : offset(offset), center(center) {}
+        glm::ivec3 operator*() const { return center + *offset; }
+        Iterator& operator++() { ++offset; return *this; }
+        Iterator operator++(int) { Iterator old = *this; ++offset; return old; }
+        bool operator==(const Iterator& other) const { return offset == other.offset; }
+        bool operator!=(const Iterator& other) const { return offset != other.offset; }
+
+    private:
+        const glm::ivec3* offset;
+        glm::ivec3 center;
+    };
+
+    // Chunk positions around `center`, for range-for
+    class Range {
+    public:
+        Range(const ChunkSpiral& spiral, const glm::ivec3& center) : spiral(spiral), center(center) {}
+        Iterator begin() const { return Iterator(spiral.offsets.data(), center); }
+        Iterator end() const { return Iterator(spiral.offsets.data() + spiral.offsets.size(), center); }
+        size_t size() const { return spiral.offsets.size(); }
+
+    private:
+        const ChunkSpiral& spiral;
+        glm::ivec3 center;
+    };
+
+    Range around(const glm::ivec3& center) const { return Range(*this, center); }
+
+    const std::vector<glm::ivec3>& getOffsets() const { return offsets; }
+    int getViewDistance() const { return viewDistance; }
+    int getVerticalDistance() const { return verticalDistance; }
+    size_t size() const { return offsets.size(); }
+
+private:
+    int viewDistance;
+    int verticalDistance;
+    std::vector<glm::ivec3> offsets;
+};
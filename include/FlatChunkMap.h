@@ -0,0 +1,202 @@
+#pragma once
+#include "ChunkLayout.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Chunk position -> V map stored in one flat array (open addressing, linear
+// probing). A lookup hashes the position and reads neighbouring slots until it
+// finds the key or an empty slot, so most of them touch a single cache line,
+// unlike std::unordered_map which allocates a node per entry.
+//
+// Erase shifts the following entries back instead of leaving tombstones, so
+// lookups don't slow down as chunks are loaded and unloaded. Like any
+// open-addressing table, insert and erase invalidate iterators and pointers to
+// values: collect the keys first, then erase (see World::unloadFarChunks).
+//
+// The position (INT_MIN, INT_MIN, INT_MIN) marks empty slots and can't be a
+// key, chunk positions never get anywhere near it.
+template <typename V>
+class FlatChunkMap {
+public:
+    using key_type = glm::ivec3;
+    using mapped_type = V;
+    using value_type = std::pair<glm::ivec3, V>;
+
+    template <bool Const>
+    class Iterator {
+    public:
+        using value_type = std::pair<glm::ivec3, V>;
+        using Slot = typename std::conditional<Const, const value_type, value_type>::type;
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Slot*;
+        using reference = Slot&;
+
+        Iterator() = default;
+        Iterator(Slot* slot, Slot* end) : slot(slot), end(end) { skipEmpty(); }
+        // iterator -> const_iterator
+        template <bool C = Const, typename = typename std::enable_if<C>::type>
+        Iterator(const Iterator<false>& other) : slot(other.slot), end(other.end) {}
+
+        Slot& operator*() const { return *slot; }
+        Slot* operator->() const { return slot; }
+        Iterator& operator++() { slot++; skipEmpty(); return *this; }
+        Iterator operator++(int) { Iterator old = *this; ++*this; return old; }
+        bool operator==(const Iterator& o) const { return slot == o.slot; }
+        bool operator!=(const Iterator& o) const { return slot != o.slot; }
+
+    private:
+        friend class FlatChunkMap;
+        friend class Iterator<!Const>;
+        Slot* slot = nullptr;
+        Slot* end = nullptr;
+
+        void skipEmpty() {
+            while (slot != end && isEmptyKey(slot->first)) slot++;
+        }
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatChunkMap() = default;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return slots.size(); }
+
+    iterator begin() { return iterator(slots.data(), slots.data() + slots.size()); }
+    iterator end() { return iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+    const_iterator begin() const { return const_iterator(slots.data(), slots.data() + slots.size()); }
+    const_iterator end() const { return const_iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+
+    iterator find(const glm::ivec3& key) {
+        size_t i = findSlot(key);
+        return i == NOT_FOUND ? end() : iteratorAt(i);
+    }
+    const_iterator find(const glm::ivec3& key) const {
+        size_t i = findSlot(key);
+        return i == NOT_FOUND ? end() : const_iterator(slots.data() + i, slots.data() + slots.size());
+    }
+    bool contains(const glm::ivec3& key) const { return findSlot(key) != NOT_FOUND; }
+
+    // nullptr if the key is absent. Cheaper than find() as it skips the iterator.
+    V* get(const glm::ivec3& key) {
+        size_t i = findSlot(key);
+        return i == NOT_FOUND ? nullptr : &slots[i].second;
+    }
+    const V* get(const glm::ivec3& key) const {
+        size_t i = findSlot(key);
+        return i == NOT_FOUND ? nullptr : &slots[i].second;
+    }
+
+    // Inserts a default value if the key is absent
+    V& operator[](const glm::ivec3& key) {
+        if ((count + 1) * MAX_LOAD_DEN > slots.size() * MAX_LOAD_NUM) grow();
+        size_t i = bucketOf(key);
+        while (!isEmptyKey(slots[i].first)) {
+            if (slots[i].first == key) return slots[i].second;
+            i = (i + 1) & mask;
+        }
+        slots[i].first = key;
+        count++;
+        return slots[i].second;
+    }
+
+    bool erase(const glm::ivec3& key) {
+        size_t i = findSlot(key);
+        if (i == NOT_FOUND) return false;
+        eraseSlot(i);
+        return true;
+    }
+    void erase(iterator it) { eraseSlot(static_cast<size_t>(it.slot - slots.data())); }
+
+    void clear() {
+        for (auto& slot : slots) slot = value_type(emptyKey(), V());
+        count = 0;
+    }
+
+    // Room for `n` entries without rehashing
+    void reserve(size_t n) {
+        size_t wanted = MIN_CAPACITY;
+        while (n * MAX_LOAD_DEN > wanted * MAX_LOAD_NUM) wanted *= 2;
+        if (wanted > slots.size()) rehash(wanted);
+    }
+
+    // Mean number of slots read by a successful lookup (1 = no collision)
+    float averageProbeLength() const {
+        if (count == 0) return 0.0f;
+        size_t total = 0;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (!isEmptyKey(slots[i].first)) total += ((i - bucketOf(slots[i].first)) & mask) + 1;
+        }
+        return static_cast<float>(total) / count;
+    }
+
+private:
+    // Grows past 3/4 full, linear probing degrades quickly above that
+    static constexpr size_t MAX_LOAD_NUM = 3;
+    static constexpr size_t MAX_LOAD_DEN = 4;
+    static constexpr size_t MIN_CAPACITY = 64;
+    static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+    std::vector<value_type> slots;
+    size_t mask = 0;
+    size_t count = 0;
+
+    static glm::ivec3 emptyKey() { return glm::ivec3(INT_MIN, INT_MIN, INT_MIN); }
+    static bool isEmptyKey(const glm::ivec3& key) {
+        return key.x == INT_MIN && key.y == INT_MIN && key.z == INT_MIN;
+    }
+
+    size_t bucketOf(const glm::ivec3& key) const { return IVec3Hash()(key) & mask; }
+
+    iterator iteratorAt(size_t i) { return iterator(slots.data() + i, slots.data() + slots.size()); }
+
+    size_t findSlot(const glm::ivec3& key) const {
+        if (count == 0) return NOT_FOUND;
+        size_t i = bucketOf(key);
+        while (true) {
+            const glm::ivec3& k = slots[i].first;
+            if (k == key) return i;
+            if (isEmptyKey(k)) return NOT_FOUND;
+            i = (i + 1) & mask;
+        }
+    }
+
+    // Backward shift: moves back every following entry of the run that would
+    // no longer be reachable from its bucket once slot `i` is empty
+    void eraseSlot(size_t i) {
+        size_t next = (i + 1) & mask;
+        while (!isEmptyKey(slots[next].first)) {
+            size_t home = bucketOf(slots[next].first);
+            // `next` may move to `i` if its bucket is not in (i, next]
+            if (((next - home) & mask) >= ((next - i) & mask)) {
+                slots[i] = std::move(slots[next]);
+                i = next;
+            }
+            next = (next + 1) & mask;
+        }
+        slots[i] = value_type(emptyKey(), V());
+        count--;
+    }
+
+    void grow() { rehash(slots.empty() ? MIN_CAPACITY : slots.size() * 2); }
+
+    void rehash(size_t newCapacity) {
+        std::vector<value_type> old;
+        old.swap(slots);
+        slots.assign(newCapacity, value_type(emptyKey(), V()));
+        mask = newCapacity - 1;
+        for (auto& slot : old) {
+            if (isEmptyKey(slot.first)) continue;
+            size_t i = bucketOf(slot.first);
+            while (!isEmptyKey(slots[i].first)) i = (i + 1) & mask;
+            slots[i] = std::move(slot);
+        }
+    }
+};
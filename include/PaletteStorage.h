@@ -0,0 +1,77 @@
+#pragma once
+#include "Block.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Palette-compressed block storage.
+// Every entry is an index into a small palette of block types. The indices are
+// bit-packed into 64-bit words and their width grows from 0 to 1 to 4 to 8 bits
+// as new types are added to the palette. With a single type in the palette
+// (0 bits) no packed data is allocated at all.
+class PaletteStorage {
+public:
+    explicit PaletteStorage(size_t size, BlockType fill = AIR);
+
+    BlockType get(size_t index) const {
+        if (bits == 0) return palette[0];
+        return palette[readIndex(data, bitsShift, index)];
+    }
+    void set(size_t index, BlockType type);
+
+    // Decodes every entry into `out` (size() contiguous types)
+    void unpack(BlockType* out) const;
+
+    // Bulk operations, working on whole packed words (two at a time with SSE2)
+    // instead of entry by entry.
+    // Sets the entries [begin, end) to `type`
+    void fill(size_t begin, size_t end, BlockType type);
+    // Every `from` entry becomes `to`. Only renames the palette entry when
+    // `to` isn't in the palette yet.
+    void replace(BlockType from, BlockType to);
+    // Number of entries of [begin, end) holding `type`
+    size_t count(BlockType type, size_t begin, size_t end) const;
+    // Same encoding (bits, palette and words), compare compacted storages
+    bool sameContent(const PaletteStorage& other) const;
+
+    // Drops the palette entries that are no longer used and shrinks the
+    // indices accordingly. A storage holding a single type becomes uniform.
+    void compact();
+
+    bool isUniform() const { return bits == 0; }
+    size_t size() const { return entryCount; }
+    int getBitsPerEntry() const { return bits; }
+    const std::vector<BlockType>& getPalette() const { return palette; }
+    const std::vector<uint64_t>& getWords() const { return data; }
+
+    // Replaces the content with raw palette data (as returned by getPalette/getWords).
+    // Returns false and leaves the storage untouched if the data is inconsistent
+    // (unknown or repeated types in the palette, indices past its end...).
+    bool assign(std::vector<BlockType> newPalette, int newBits, std::vector<uint64_t> words);
+
+    static size_t wordCount(size_t entries, int bits);
+
+    // Heap + inline bytes used by this storage
+    size_t memoryUsage() const;
+
+private:
+    size_t entryCount;
+    int bits;           // bits per entry: 0, 1, 4 or 8
+    int bitsShift;      // log2(bits) when bits > 0
+    std::vector<BlockType> palette;
+    std::vector<uint64_t> data;
+
+    // Entries never straddle two words since 1, 4 and 8 all divide 64
+    static uint32_t readIndex(const std::vector<uint64_t>& words, int bitsShift, size_t index) {
+        int perWordShift = 6 - bitsShift;
+        int offset = static_cast<int>(index & ((size_t(1) << perWordShift) - 1)) << bitsShift;
+        uint64_t mask = (1ull << (1 << bitsShift)) - 1;
+        return static_cast<uint32_t>((words[index >> perWordShift] >> offset) & mask);
+    }
+    static void writeIndex(std::vector<uint64_t>& words, int bitsShift, size_t index, uint32_t value);
+
+    uint32_t paletteIndexOf(BlockType type);
+    // Position in the palette, -1 if absent
+    int findPaletteIndex(BlockType type) const;
+    void repack(int newBits, const std::vector<uint32_t>& remap = {});
+};
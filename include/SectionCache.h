@@ -0,0 +1,60 @@
+#pragma once
+#include "ChunkSection.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Deduplicates sections by content: chunks holding identical sections (all
+// air, all stone, the same generated layer...) point to one shared copy.
+//
+// The cache keeps a reference to every section it hands out, so an interned
+// section is always shared and Chunk copies it before any edit (see
+// Chunk::editSection). Entries nobody else uses anymore are dropped from time
+// to time.
+class SectionCache {
+public:
+    using SectionPtr = std::shared_ptr<ChunkSection>;
+
+    struct Stats {
+        size_t lookups = 0;
+        size_t hits = 0;
+        size_t uniqueSections = 0; // non-uniform sections currently in the cache
+        size_t bytes = 0;          // memory of those sections
+    };
+
+    static SectionCache& instance();
+
+    // One section per block type, filled with it
+    const SectionPtr& uniform(BlockType type) const { return uniformSections[type]; }
+
+    // Returns the cached section with the same content as `section`, or
+    // adds `section` to the cache. Best called on compacted sections.
+    SectionPtr intern(const SectionPtr& section);
+
+    // Whether `section` is one of the interned sections (not the uniform ones)
+    bool contains(const SectionPtr& section) const;
+
+    Stats getStats() const;
+    // Drops the sections nobody uses anymore now rather than on the next
+    // sweep, returns the bytes freed
+    size_t trim();
+
+    static uint64_t contentHash(const ChunkSection& section);
+
+private:
+    SectionCache();
+
+    std::array<SectionPtr, BLOCK_TYPE_COUNT> uniformSections;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, std::vector<SectionPtr>> buckets;
+    size_t entryCount = 0;
+    static constexpr size_t MIN_SWEEP_THRESHOLD = 1024;
+    size_t sweepThreshold = MIN_SWEEP_THRESHOLD;
+    Stats stats;
+
+    void sweep();
+};
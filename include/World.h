@@ -1,14 +1,34 @@
 #pragma once
 #include "Chunk.h"
+#include "ChunkPool.h"
+#include "SectionCache.h"
+#include "ChunkColdCache.h"
+#include "FlatChunkMap.h"
+#include "ChunkRing.h"
+#include "ChunkRegistry.h"
+#include "ChunkSpiral.h"
 #include <memory>
 #include <vector>
 #include <iostream>
 #include <glm/gtx/string_cast.hpp>
 #include <unordered_map>
+#include <unordered_set>
 #include "PerlinNoise.hpp"
+#include <algorithm>
 #include <map>
+#include <limits>
+#include <sstream>
 #include <time.h>
 
+// Default memory budget of the loaded chunks, set from CMake
+#ifndef CHUNK_MEMORY_BUDGET_MB
+#define CHUNK_MEMORY_BUDGET_MB 1024
+#endif
+// RAM kept for recently unloaded chunks, see ChunkColdCache
+#ifndef CHUNK_COLD_CACHE_MB
+#define CHUNK_COLD_CACHE_MB 64
+#endif
+
 struct Structure {
     std::vector<BlockType> types;
     std::vector<glm::ivec3> positions; // positions
@@ -69,21 +89,44 @@ public:
 
     };
 
-    struct IVec3Hash {
-        size_t operator()(const glm::ivec3& v) const {
-            return ((std::hash<int>()(v.x) ^ (std::hash<int>()(v.y) << 1)) >> 1) ^ (std::hash<int>()(v.z) << 1);
-        }
-    };
+    // Owns the chunks, the map only keeps handles to them
+    ChunkPool chunkPool;
+    // Open addressing, looked up for every block query
+    FlatChunkMap<ChunkHandle> chunkMap;
+    // Same handles for the chunks of the unload window around the player, so
+    // that unloadFarChunks only sweeps its edges. Lookups go to the map alone,
+    // it is faster than trying the ring first (see --bench). Set up by unloadFarChunks.
+    ChunkRing<ChunkHandle> chunkRing;
+    // Copy of chunkMap for the worker threads, see publishChunks
+    ChunkRegistry chunkRegistry;
+    bool chunkMapChanged = false;
+    // Unloaded chunks not written back or not forgotten yet
+    ChunkColdCache coldChunks{static_cast<size_t>(CHUNK_COLD_CACHE_MB) * 1024 * 1024};
+    // Range of chunkPos.y ever loaded, bounds the vertical searches
+    int lowestChunkY = std::numeric_limits<int>::max();
+    int highestChunkY = std::numeric_limits<int>::min();
+    // Scratch of applyEdits, kept between batches
+    std::vector<std::pair<glm::ivec3, BlockEdit>> editScratch; // chunk, local edit
+    std::vector<BlockEdit> chunkEditScratch;
+    std::vector<glm::ivec3> editedChunks, remeshScratch;
+    // View offsets by (view distance, vertical distance), see getAllChunksToDraw
+    std::map<std::pair<int, int>, ChunkSpiral> spirals;
+
+    // Eviction score factor of chunks with unsaved edits
+    static constexpr float DIRTY_EVICTION_WEIGHT = 0.5f;
+
+    // getActualHeightAt when the column has no block
+    static constexpr int NO_GROUND = std::numeric_limits<int>::min();
 
-    std::unordered_map<glm::ivec3, std::shared_ptr<Chunk>, IVec3Hash> chunkMap;    
     World() {
         // Create directory for chunks if it doesn't exist
-        std::string dir = "../chunks/" + std::to_string(seed);
+        // One directory per chunk height, files of another height can't be read back
+        std::string dir = "../chunks/" + std::to_string(seed) + "/h" + std::to_string(Chunk::CHUNK_SIZE.y);
         if (system(("mkdir -p " + dir).c_str()) != 0) {
             std::cerr << "Failed to create directory: " << dir << std::endl;
         }
 
-        chunkDir = "../chunks/" + std::to_string(seed) + "/";
+        chunkDir = dir + "/";
         seed = static_cast<siv::PerlinNoise::seed_type>(time(NULL));
         perlin = siv::PerlinNoise(seed);
     }
@@ -97,25 +140,57 @@ public:
 
     
     void createChunkAt(const glm::ivec3& pos) {
-        if (chunkMap.find(pos) == chunkMap.end()) {
+        if (!chunkMap.contains(pos)) {
             auto filename = getFilenameForChunk(pos);
 
-            std::shared_ptr<Chunk> chunkPtr;
+            ChunkHandle handle = chunkPool.acquire(pos);
+            Chunk* chunkPtr = chunkPool.get(handle);
+            if (!chunkPtr) return;
 
+            if (restoreFromColdTier(pos, *chunkPtr)) {
+                // Unloaded not long ago, decoded from RAM
+            }
             // Si le chunk existe dans un fichier, on le charge
-            if (Chunk::isInFile(filename)) {
-                chunkPtr = std::make_shared<Chunk>(pos); // construit directement
+            else if (Chunk::isInFile(filename)) {
                 chunkPtr->loadFromFile(filename);
                 std::cout << "Loaded chunk from file: " << filename << std::endl;
             } else {
-                chunkPtr = std::make_shared<Chunk>(pos); // construit directement
                 chunkPtr->generate(perlin);
                 chunkPtr->saveToFile(filename);
                 std::cout << "Generated and saved chunk at " << glm::to_string(pos);
             }
 
-            chunkMap[pos] = chunkPtr;
+            chunkPtr->lastVisibleFrame = frame; // not evicted before it had a chance to be drawn
+            chunkMap[pos] = handle;
+            chunkRing.set(pos, handle);
+            chunkMapChanged = true;
+            // The neighbours drew their faces against air until now
+            if (chunkPtr->getMaxY() >= 0) {
+                static const glm::ivec3 sides[6] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+                for (const auto& side : sides) {
+                    if (Chunk* neighbour = getChunkAt(pos + side)) neighbour->requestRemesh();
+                }
+            }
+            lowestChunkY = std::min(lowestChunkY, pos.y);
+            highestChunkY = std::max(highestChunkY, pos.y);
+        }
+    }
+
+
+    // Decodes the chunk if it is in the cold tier. Its edits may not be on disk yet.
+    bool restoreFromColdTier(const glm::ivec3& pos, Chunk& chunk) {
+        ChunkColdCache::Entry cold;
+        if (!coldChunks.take(pos, cold)) return false;
+        std::istringstream in(cold.blob);
+        if (!chunk.read(in)) {
+            // Dropped: put back, it would be written over the file (or its dirty
+            // flag passed on to the chunk loaded instead) without saving anything
+            std::cerr << "Failed to decode cold chunk at " << glm::to_string(pos)
+                      << (cold.dirty ? ", its unsaved edits are lost" : "") << std::endl;
+            return false;
         }
+        if (cold.dirty) chunk.markDirty();
+        return true;
     }
 
 
@@ -126,6 +201,8 @@ public:
             return;
         }
         const Structure& structure = it->second;
+        std::vector<BlockEdit> edits;
+        edits.reserve(structure.types.size());
         for (size_t i = 0; i < structure.types.size(); ++i) {
             float prob = (i < structure.probabilities.size()) ? structure.probabilities[i] : 1.0f;
             float noiseVal = perlin.octave3D_01((basePos.x + structure.positions[i].x) * 0.1f,
@@ -134,15 +211,18 @@ public:
             if (noiseVal > prob) continue; // skip this block based on probability
             BlockType type = structure.types[i];
             glm::ivec3 offset = structure.positions[i];
-            Block block;
-            block.type = type;
-            block.position = glm::vec3(basePos + offset);
-            placeBlock(block);
+            edits.push_back({basePos + offset, type});
         }
+        applyEdits(edits);
     }
 
 
+    // Once per loaded chunk. A chunk created by a tree spilling from the one
+    // below still gets its own trees planted when it comes up here.
     void generateStructureInChunk(const glm::ivec3& chunkPos) {
+        Chunk* chunk = getChunkAt(chunkPos);
+        if (!chunk || chunk->structuresGenerated) return;
+        chunk->structuresGenerated = true;
         // Generate trees
         // Use perlin noise to decide if we place a tree
         for (int x = 0; x < Chunk::CHUNK_SIZE.x; x++) {
@@ -153,10 +233,12 @@ public:
                 if (treeChance > 0.8f) {
                     // Check ground block type
                     int height = getHeightAt(worldX, worldZ);
+                    // Only the chunk holding the surface plants the tree
+                    if (ChunkLayout::chunkOf({worldX, height, worldZ}).y != chunkPos.y) continue;
                     glm::ivec3 treeBasePos = {worldX, height, worldZ};
                     if (!isBlockSolid(treeBasePos)) continue;
                     Block belowBlock = getBlockAt(treeBasePos); // Structure is relative to ground so no need to subtract 1
-                    if (belowBlock.type != GRASS && belowBlock.type != DIRT) continue;
+                    if (!blockInfo(belowBlock.type).soil) continue;
                     placeStructure("tree", treeBasePos);
                     z += 3; // éviter de placer des arbres trop proches
                     x += 3;
@@ -166,92 +248,76 @@ public:
     }
 
     int getHeightAt(int worldX, int worldZ) {
-        glm::ivec3 chunkPos = {
-            divFloor(worldX, Chunk::CHUNK_SIZE.x),
-            0,
-            divFloor(worldZ, Chunk::CHUNK_SIZE.z)
-        };
-        glm::ivec3 localPos = {
-            worldX - chunkPos.x * Chunk::CHUNK_SIZE.x,
-            Chunk::CHUNK_SIZE.y - 1, // start from top
-            worldZ - chunkPos.z * Chunk::CHUNK_SIZE.z
-        };
         int elevation = static_cast<int>(perlin.octave2D_01(worldX * 0.01f, worldZ * 0.01f, 6) * 80.0f);
         return elevation;
     }
 
-    int getActualHeightAt(int worldX, int worldZ) {
-        glm::ivec3 chunkPos = {
-            divFloor(worldX, Chunk::CHUNK_SIZE.x),
-            0,
-            divFloor(worldZ, Chunk::CHUNK_SIZE.z)
-        };
-        Chunk* chunk = getChunkAt(chunkPos);
-        if (!chunk) return -1; // chunk non généré
-
-        glm::ivec3 localPos = {
-            worldX - chunkPos.x * Chunk::CHUNK_SIZE.x,
-            Chunk::CHUNK_SIZE.y - 1, // start from top
-            worldZ - chunkPos.z * Chunk::CHUNK_SIZE.z
-        };
-
-        for (int y = Chunk::CHUNK_SIZE.y - 1; y >= 0; y--) {
-            localPos.y = y;
-            Block block = chunk->getBlockAt(localPos);
-            if (block.type != AIR) {
-                return y + chunkPos.y * Chunk::CHUNK_SIZE.y;
-            }
+    // World y of the highest loaded non-air block of a column at or below maxY,
+    // NO_GROUND if there is none. Walks the chunks of the column downwards.
+    int getActualHeightAt(int worldX, int worldZ, int maxY = std::numeric_limits<int>::max()) {
+        if (chunkMap.empty()) return NO_GROUND;
+        glm::ivec3 chunkPos = ChunkLayout::chunkOf({worldX, 0, worldZ});
+        glm::ivec3 localPos = ChunkLayout::localOf({worldX, 0, worldZ});
+        const int maxChunkY = maxY >> ChunkLayout::SHIFT_Y;
+
+        for (int cy = std::min(maxChunkY, highestChunkY); cy >= lowestChunkY; cy--) {
+            chunkPos.y = cy;
+            Chunk* chunk = getChunkAt(chunkPos);
+            if (!chunk) continue; // chunk non généré
+
+            int y = cy == maxChunkY ? chunk->getHighestBlockAt(localPos.x, localPos.z, maxY & ChunkLayout::MASK_Y)
+                                    : chunk->getHighestBlockAt(localPos.x, localPos.z);
+            if (y >= 0) return y + cy * Chunk::CHUNK_SIZE.y;
         }
-        return -1; // no solid block found
+        return NO_GROUND;
     }
     
     bool isBlockSolid(const glm::ivec3& worldPos) {
-        // Calcul de la position du chunk correspondant
-        glm::ivec3 chunkPos = {
-            divFloor(worldPos.x, Chunk::CHUNK_SIZE.x),
-            divFloor(worldPos.y, Chunk::CHUNK_SIZE.y),
-            divFloor(worldPos.z, Chunk::CHUNK_SIZE.z)
-        };
-
-        Chunk* chunk = getChunkAt(chunkPos);
+        Chunk* chunk = getChunkAt(ChunkLayout::chunkOf(worldPos));
         if (!chunk) return false; // chunk non généré => bloc vide
 
-        // Coordonnées locales dans le chunk
-        glm::ivec3 localPos = worldPos - chunkPos * Chunk::CHUNK_SIZE;
+        return chunk->isSolidAt(ChunkLayout::localOf(worldPos));
+    }
 
-        // Vérifie que la position est valide
-        if (localPos.x < 0 || localPos.x >= Chunk::CHUNK_SIZE.x ||
-            localPos.y < 0 || localPos.y >= Chunk::CHUNK_SIZE.y ||
-            localPos.z < 0 || localPos.z >= Chunk::CHUNK_SIZE.z) {
-            return false;
-        }
 
-        Block block = chunk->getBlockAt(localPos);
-        return block.type != AIR;
+    // Whether a chunk is within `distance` chunks horizontally and
+    // `verticalDistance` chunks vertically of `center`
+    static bool isInRange(const glm::ivec3& chunkPos, const glm::ivec3& center, float distance, int verticalDistance) {
+        glm::ivec3 d = chunkPos - center;
+        return std::abs(d.y) <= verticalDistance && glm::length(glm::vec2(d.x, d.z)) <= distance;
     }
 
-
-    void generateChunks(int radius, glm::ivec3 centerChunk) {
+    void generateChunks(int radius, glm::ivec3 centerChunk, int verticalRadius) {
         for (int x = -radius; x <= radius; x++) {
             for (int z = -radius; z <= radius; z++) {
-                glm::ivec3 chunkPos = centerChunk + glm::ivec3(x, 0, z);
-                createChunkAt(chunkPos);
-                generateStructureInChunk(chunkPos);
+                // Bottom up, trees may spill into the chunk above
+                for (int y = -verticalRadius; y <= verticalRadius; y++) {
+                    glm::ivec3 chunkPos = centerChunk + glm::ivec3(x, y, z);
+                    createChunkAt(chunkPos);
+                    generateStructureInChunk(chunkPos);
+                }
             }
         }
         std::cout << "Generated " << chunkMap.size() << " chunks.\n";
+        publishChunks();
+    }
+
+    // Makes the chunks loaded and unloaded since the last call visible to the
+    // worker threads (chunkRegistry). Once per frame is enough.
+    void publishChunks() {
+        if (!chunkMapChanged) return;
+        chunkRegistry.publish(chunkMap);
+        chunkMapChanged = false;
     }
 
     Chunk* getChunkAt(const glm::ivec3& pos) {
-        auto it = chunkMap.find(pos);
-        if (it != chunkMap.end())
-            return it->second.get();  // shared_ptr -> raw pointer
-        return nullptr;
+        const ChunkHandle* handle = chunkMap.get(pos);
+        return handle ? chunkPool.get(*handle) : nullptr;
     }
 
     
-    void placeBlock(Block block, bool byUser = true) {
-        glm::ivec3 chunkPos = glm::floor(glm::vec3(block.position) / glm::vec3(Chunk::CHUNK_SIZE));
+    void placeBlock(const glm::ivec3& worldPos, BlockType type) {
+        glm::ivec3 chunkPos = ChunkLayout::chunkOf(worldPos);
 
         Chunk* chunk = getChunkAt(chunkPos);
         if (!chunk) {
@@ -260,110 +326,363 @@ public:
             if (!chunk) return;             // sécurité absolue
         }
 
-        glm::ivec3 localPos = block.position - chunkPos * Chunk::CHUNK_SIZE;
+        glm::ivec3 localPos = ChunkLayout::localOf(worldPos);
+        chunk->setBlockAt(localPos, type); // bumps the version, the mesher picks it up
+        remeshNeighboursOf(chunkPos, localPos);
+    }
+
+    // Meshes hide the faces against the neighbouring chunks: an edit on the
+    // border of a chunk changes the mesh of the chunk next to it
+    void remeshNeighboursOf(const glm::ivec3& chunkPos, const glm::ivec3& localPos) {
+        forEachFacingNeighbour(chunkPos, localPos, [this](const glm::ivec3& neighbourPos) {
+            if (Chunk* neighbour = getChunkAt(neighbourPos)) neighbour->requestRemesh();
+        });
+    }
 
-        if (localPos.x < 0 || localPos.x >= Chunk::CHUNK_SIZE.x ||
-            localPos.y < 0 || localPos.y >= Chunk::CHUNK_SIZE.y ||
-            localPos.z < 0 || localPos.z >= Chunk::CHUNK_SIZE.z) {
-            std::cerr << "placeBlock: localPos hors limites ! " << localPos.x << ", " << localPos.y << ", " << localPos.z << std::endl;
-            return;
+    // Chunks sharing a face with the block at `localPos`, 0 to 3 of them
+    template <typename F>
+    static void forEachFacingNeighbour(const glm::ivec3& chunkPos, const glm::ivec3& localPos, F f) {
+        for (int axis = 0; axis < 3; axis++) {
+            int side = localPos[axis] == 0 ? -1 : (localPos[axis] == Chunk::CHUNK_SIZE[axis] - 1 ? 1 : 0);
+            if (side == 0) continue;
+            glm::ivec3 neighbourPos = chunkPos;
+            neighbourPos[axis] += side;
+            f(neighbourPos);
+        }
+    }
+
+    // Sets blocks in bulk (world positions, applied in order like placeBlock,
+    // missing chunks are created). The edits are grouped by chunk: every chunk
+    // touched gets one Chunk::setBlocks, so one version bump, and every
+    // neighbour with a changed border one remesh request, whatever the size
+    // of the batch.
+    void applyEdits(const BlockEdit* edits, size_t count) {
+        if (count == 0) return;
+        editScratch.clear();
+        for (size_t i = 0; i < count; i++) {
+            editScratch.push_back({ChunkLayout::chunkOf(edits[i].pos),
+                                   {ChunkLayout::localOf(edits[i].pos), edits[i].type}});
+        }
+        // Stable so that the edits of one block keep their order
+        std::stable_sort(editScratch.begin(), editScratch.end(),
+                         [](const auto& a, const auto& b) { return lessChunkPos(a.first, b.first); });
+
+        editedChunks.clear();
+        remeshScratch.clear();
+        for (size_t begin = 0, end; begin < editScratch.size(); begin = end) {
+            const glm::ivec3 chunkPos = editScratch[begin].first;
+            chunkEditScratch.clear();
+            for (end = begin; end < editScratch.size() && editScratch[end].first == chunkPos; end++) {
+                const BlockEdit& edit = editScratch[end].second;
+                chunkEditScratch.push_back(edit);
+                forEachFacingNeighbour(chunkPos, edit.pos, [this](const glm::ivec3& neighbourPos) {
+                    remeshScratch.push_back(neighbourPos);
+                });
+            }
+
+            Chunk* chunk = getChunkAt(chunkPos);
+            if (!chunk) {
+                createChunkAt(chunkPos);
+                chunk = getChunkAt(chunkPos);
+                if (!chunk) continue;
+            }
+            chunk->setBlocks(chunkEditScratch.data(), chunkEditScratch.size());
+            editedChunks.push_back(chunkPos); // sorted, like editScratch
         }
 
-        chunk->setBlockAt(localPos, block.type);
-        chunk->meshGenerated = false; // for regeneration
+        // The chunks edited in the batch are remeshed anyway
+        std::sort(remeshScratch.begin(), remeshScratch.end(), lessChunkPos);
+        remeshScratch.erase(std::unique(remeshScratch.begin(), remeshScratch.end()), remeshScratch.end());
+        for (const glm::ivec3& neighbourPos : remeshScratch) {
+            if (std::binary_search(editedChunks.begin(), editedChunks.end(), neighbourPos, lessChunkPos)) continue;
+            if (Chunk* neighbour = getChunkAt(neighbourPos)) neighbour->requestRemesh();
+        }
     }
+    void applyEdits(const std::vector<BlockEdit>& edits) { applyEdits(edits.data(), edits.size()); }
 
-    Block getBlockAt(const glm::ivec3& worldPos) {
-        glm::ivec3 chunkPos = {
-            divFloor(worldPos.x, Chunk::CHUNK_SIZE.x),
-            divFloor(worldPos.y, Chunk::CHUNK_SIZE.y),
-            divFloor(worldPos.z, Chunk::CHUNK_SIZE.z)
-        };
+    static bool lessChunkPos(const glm::ivec3& a, const glm::ivec3& b) {
+        if (a.x != b.x) return a.x < b.x;
+        if (a.y != b.y) return a.y < b.y;
+        return a.z < b.z;
+    }
 
-        Chunk* chunk = getChunkAt(chunkPos);
+    Block getBlockAt(const glm::ivec3& worldPos) {
+        Chunk* chunk = getChunkAt(ChunkLayout::chunkOf(worldPos));
         if (!chunk) {
-            static Block airBlock = {{0,0,0}, AIR};
+            static Block airBlock = {AIR};
             return airBlock; // Return an AIR block if chunk doesn't exist
         }
 
-        glm::ivec3 localPos = worldPos - chunkPos * Chunk::CHUNK_SIZE;
+        return chunk->getBlockAt(ChunkLayout::localOf(worldPos));
+    }
 
-        if (localPos.x < 0 || localPos.x >= Chunk::CHUNK_SIZE.x ||
-            localPos.y < 0 || localPos.y >= Chunk::CHUNK_SIZE.y ||
-            localPos.z < 0 || localPos.z >= Chunk::CHUNK_SIZE.z) {
-            static Block airBlock = {{0,0,0}, AIR};
-            return airBlock; // Return an AIR block if out of bounds
-        }
 
-        return chunk->getBlockAt(localPos);
+    const BlockData* getBlockData(const glm::ivec3& worldPos) {
+        Chunk* chunk = getChunkAt(ChunkLayout::chunkOf(worldPos));
+        if (!chunk) return nullptr;
+        return chunk->getBlockData(ChunkLayout::localOf(worldPos));
     }
 
+    bool setBlockData(const glm::ivec3& worldPos, BlockData data) {
+        Chunk* chunk = getChunkAt(ChunkLayout::chunkOf(worldPos));
+        if (!chunk) return false;
+        return chunk->setBlockData(ChunkLayout::localOf(worldPos), std::move(data));
+    }
 
-    std::vector<glm::ivec3> getAllChunksToDraw(glm::ivec3 playerChunkPos, int viewDistance) {
-        std::vector<glm::ivec3> chunksToDraw;
-        for (int x = -viewDistance; x <= viewDistance; x++) {
-            for (int z = -viewDistance; z <= viewDistance; z++) {
-                glm::ivec3 chunkPos = playerChunkPos + glm::ivec3(x, 0, z);
-                chunkPos.y = 0; // For now, only ground level
-                // Check for distance to avoid square shape
-                if (glm::length(glm::vec2(x, z)) > viewDistance) continue;
-                chunksToDraw.push_back(chunkPos);
-            }
-        }
-        return chunksToDraw;
+
+    // Positions of the chunks in view around the player, loaded or not, nearest
+    // first. The offsets are sorted once per pair of distances (see ChunkSpiral).
+    ChunkSpiral::Range getAllChunksToDraw(glm::ivec3 playerChunkPos, int viewDistance, int verticalDistance) {
+        auto key = std::make_pair(viewDistance, verticalDistance);
+        auto it = spirals.find(key);
+        if (it == spirals.end()) it = spirals.emplace(key, ChunkSpiral(viewDistance, verticalDistance)).first;
+        return it->second.around(playerChunkPos);
     }
 
-    void unloadFarChunks(glm::ivec3 playerChunkPos, int viewDistance) {
+    // Unloads the chunks further than viewDistance + 2 horizontally or
+    // verticalDistance + 1 vertically. The chunk ring is a box of that size,
+    // so when the player moves only the chunks of the slabs that left it and
+    // of the rim of the disc are checked, not every loaded chunk.
+    void unloadFarChunks(glm::ivec3 playerChunkPos, int viewDistance, int verticalDistance) {
+        const int radius = viewDistance + 2;
+        const int vertical = verticalDistance + 1;
         std::vector<glm::ivec3> chunksToRemove;
-        for (const auto& pair : chunkMap) {
-            const glm::ivec3& chunkPos = pair.first;
-            if (glm::length(glm::vec2(chunkPos.x - playerChunkPos.x, chunkPos.z - playerChunkPos.z)) > viewDistance + 2) {
-                chunksToRemove.push_back(chunkPos);
+
+        if (chunkRing.getRadius() != radius || chunkRing.getVerticalRadius() != vertical
+            || chunkRing.size() != chunkMap.size()) {
+            // First call, other distances, or chunks loaded outside of the
+            // window: full scan, then the ring is rebuilt from what's left
+            chunkRing.reset(playerChunkPos, radius, vertical);
+            for (const auto& pair : chunkMap) {
+                if (!isInRange(pair.first, playerChunkPos, radius, vertical)) chunksToRemove.push_back(pair.first);
+                else chunkRing.set(pair.first, pair.second);
+            }
+        } else if (chunkRing.getCenter() != playerChunkPos) {
+            glm::ivec3 oldCenter = chunkRing.getCenter();
+            chunkRing.recenter(playerChunkPos, [&](const glm::ivec3& pos, const ChunkHandle&) {
+                chunksToRemove.push_back(pos);
+            });
+
+            // Still in the box but out of the disc: for each row of the new
+            // window, the z range that was in the old disc and is not anymore
+            for (int dx = -radius; dx <= radius; dx++) {
+                int x = playerChunkPos.x + dx;
+                int newHalf = discHalfWidth(dx, radius);
+                int oldHalf = discHalfWidth(x - oldCenter.x, radius);
+                if (oldHalf < 0) continue;
+                int zMin = std::max(oldCenter.z - oldHalf, playerChunkPos.z - radius);
+                int zMax = std::min(oldCenter.z + oldHalf, playerChunkPos.z + radius);
+                for (int z = zMin; z <= zMax; z++) {
+                    if (std::abs(z - playerChunkPos.z) <= newHalf) continue;
+                    for (int y = playerChunkPos.y - vertical; y <= playerChunkPos.y + vertical; y++) {
+                        if (chunkRing.get({x, y, z})) chunksToRemove.push_back({x, y, z});
+                    }
+                }
             }
         }
+
         for (const auto& pos : chunksToRemove) {
-            auto it = chunkMap.find(pos);
-            if (it != chunkMap.end()) {
-                // Save chunk to file before removing
-                if (it->second->busy) {
-                    std::cout << "Chunk at " << glm::to_string(pos) << " is busy, skipping unload.\n";
-                    continue; // skip if busy
-                }
-                std::string filename = getFilenameForChunk(pos);
-                auto chunk = it->second;    // shared_ptr garde vivant
-                chunkMap.erase(it);          // supprime map, chunk reste alive si thread l’utilise
-                chunk->saveToFile(filename);
+            if (unloadChunk(pos)) std::cout << "Unloaded chunk at " << glm::to_string(pos) << std::endl;
+        }
+    }
+
+    // Largest |dz| with (dx, dz) in the disc of isInRange, -1 if none
+    static int discHalfWidth(int dx, int radius) {
+        if (std::abs(dx) > radius) return -1;
+        int half = static_cast<int>(std::sqrt(static_cast<float>(radius * radius - dx * dx)));
+        while (glm::length(glm::vec2(dx, half + 1)) <= radius) half++;
+        while (half >= 0 && glm::length(glm::vec2(dx, half)) > radius) half--;
+        return half;
+    }
 
-                std::cout << "Unloaded chunk at " << glm::to_string(pos) << std::endl;
+    // Moves the chunk to the cold tier and gives it back to the pool. Its
+    // edits reach the disk when it leaves the cold tier (or on saveAll).
+    bool unloadChunk(const glm::ivec3& pos) {
+        auto it = chunkMap.find(pos);
+        if (it == chunkMap.end()) return false;
+        if (Chunk* chunk = chunkPool.get(it->second)) {
+            std::ostringstream out;
+            if (chunk->write(out)) {
+                coldChunks.put(pos, out.str(), chunk->isDirty());
+            } else if (chunk->isDirty()) {
+                chunk->saveToFile(getFilenameForChunk(pos));
             }
         }
+        // A worker still meshing it only delays the recycling
+        chunkPool.release(it->second);
+        chunkMap.erase(it);
+        chunkRing.erase(pos);
+        chunkMapChanged = true;
+
+        ChunkColdCache::Entry old;
+        while (coldChunks.popOverflow(old)) writeBack(old);
+        return true;
     }
 
-    void removeBlock(const glm::ivec3& worldPos) {
-        glm::ivec3 chunkPos = {
-            divFloor(worldPos.x, Chunk::CHUNK_SIZE.x),
-            divFloor(worldPos.y, Chunk::CHUNK_SIZE.y),
-            divFloor(worldPos.z, Chunk::CHUNK_SIZE.z)
-        };
+    void writeBack(const ChunkColdCache::Entry& entry) {
+        if (entry.dirty) Chunk::saveEncoded(getFilenameForChunk(entry.pos), entry.blob);
+    }
 
-        Chunk* chunk = getChunkAt(chunkPos);
-        if (!chunk) return; // chunk non généré
+    // Writes every unsaved edit to disk, loaded chunks and cold tier alike
+    void saveAll() {
+        for (const auto& pair : chunkMap) {
+            Chunk* chunk = chunkPool.get(pair.second);
+            if (chunk->isDirty()) chunk->saveToFile(getFilenameForChunk(pair.first));
+        }
+        ChunkColdCache::Entry entry;
+        while (coldChunks.popOldest(entry)) writeBack(entry);
+    }
+
+    // Memory taken by the loaded chunks, checked against memoryBudget
+    struct MemoryUsage {
+        size_t blockBytes = 0; // Chunk objects, sections and block data, shared sections once
+        size_t meshBytes = 0;  // CPU mesh buffers of the pool, in use or free
+        size_t gpuBytes = 0;   // vertex and index buffers
+        size_t evictions = 0;  // chunks unloaded to stay under the budget so far
+
+        size_t total() const { return blockBytes + meshBytes + gpuBytes; }
+    };
 
-        glm::ivec3 localPos = worldPos - chunkPos * Chunk::CHUNK_SIZE;
+    size_t memoryBudget = static_cast<size_t>(CHUNK_MEMORY_BUDGET_MB) * 1024 * 1024;
+    // Bumped once per frame by the main loop, see Chunk::lastVisibleFrame
+    uint64_t frame = 1;
+    MemoryUsage memoryUsage; // as of the last enforceMemoryBudget
+
+    const MemoryUsage& getMemoryUsage() const { return memoryUsage; }
+    // No new chunk should be loaded while this is true
+    bool isOverBudget() const { return memoryUsage.total() > memoryBudget; }
+
+    // Recomputes the memory usage and, above the budget, unloads the chunks
+    // that are out of view, starting with the far ones, the ones not seen for
+    // long and the ones that don't need a save. Chunks in view are kept: if
+    // they alone don't fit, isOverBudget() stays true and loading stops.
+    void enforceMemoryBudget(const glm::ivec3& playerChunkPos) {
+        MemoryUsage usage;
+        usage.evictions = memoryUsage.evictions;
+        usage.meshBytes = chunkPool.getStats().meshBufferBytes;
+        // Sections interned in the cache are shared by many chunks (all the air
+        // and plain stone ones), they are counted once through the cache
+        usage.blockBytes = SectionCache::instance().getStats().bytes;
+        for (const auto& pair : chunkMap) {
+            const Chunk* chunk = chunkPool.get(pair.second);
+            usage.blockBytes += sizeof(Chunk) + chunk->ownedMemoryUsage();
+            usage.gpuBytes += chunk->gl.bytes;
+        }
+        memoryUsage = usage;
+        if (!isOverBudget()) return;
+
+        // Memory nobody uses goes first: spare mesh buffers of the pool (evicting
+        // chunks never shrinks them) and cached sections left by unloads and edits
+        memoryUsage.meshBytes -= chunkPool.trimMeshes();
+        memoryUsage.blockBytes -= SectionCache::instance().trim();
+        if (!isOverBudget()) return;
+
+        struct Candidate {
+            float score; // higher goes first
+            glm::ivec3 pos;
+        };
+        std::vector<Candidate> candidates;
+        for (const auto& pair : chunkMap) {
+            const Chunk* chunk = chunkPool.get(pair.second);
+            uint64_t unseenFrames = frame - chunk->lastVisibleFrame;
+            if (unseenFrames <= 1) continue; // in view
+            float distance = glm::length(glm::vec3(pair.first - playerChunkPos));
+            // Unseen for a second (at 60 fps) weighs like one chunk of distance
+            float score = distance + unseenFrames / 60.0f;
+            if (chunk->isDirty()) score *= DIRTY_EVICTION_WEIGHT; // costs a disk write
+            candidates.push_back({score, pair.first});
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+
+        // A bit under the budget, not to evict again on the next frame
+        const size_t target = memoryBudget - memoryBudget / 10;
+        size_t evicted = 0;
+        for (const Candidate& c : candidates) {
+            if (memoryUsage.total() <= target) break;
+            const Chunk* chunk = getChunkAt(c.pos);
+            memoryUsage.blockBytes -= std::min(memoryUsage.blockBytes, sizeof(Chunk) + chunk->releasableMemoryUsage());
+            memoryUsage.gpuBytes -= chunk->gl.bytes;
+            unloadChunk(c.pos);
+            evicted++;
+        }
+        if (evicted) SectionCache::instance().trim(); // the sections only the evicted chunks used
+        memoryUsage.evictions += evicted;
+        if (evicted) {
+            std::cout << "Memory budget: evicted " << evicted << " chunks, "
+                      << memoryUsage.total() / (1024 * 1024) << " / " << memoryBudget / (1024 * 1024) << " MB" << std::endl;
+        }
+    }
 
-        if (localPos.x < 0 || localPos.x >= Chunk::CHUNK_SIZE.x ||
-            localPos.y < 0 || localPos.y >= Chunk::CHUNK_SIZE.y ||
-            localPos.z < 0 || localPos.z >= Chunk::CHUNK_SIZE.z) {
-            return; // out of bounds
+    // Prints how much memory the block storage of the loaded chunks uses,
+    // compared to a dense one-byte-per-block array
+    void printMemoryReport() {
+        size_t chunkCount = chunkMap.size();
+        if (chunkCount == 0) {
+            std::cout << "Memory report: no chunk loaded\n";
+            return;
         }
 
-        chunk->setBlockAt(localPos, AIR);
-        chunk->meshGenerated = false; // for regeneration
+        size_t paletteBytes = 0;
+        size_t sharedBytes = 0; // each physical section counted once
+        std::unordered_set<const ChunkSection*> physicalSections;
+        size_t emptySections = 0;
+        size_t uniformSections = 0;
+        size_t bitsHistogram[9] = {0};
+        std::array<size_t, BLOCK_TYPE_COUNT> census{};
+        for (const auto& pair : chunkMap) {
+            const Chunk* chunk = chunkPool.get(pair.second);
+            paletteBytes += chunk->memoryUsage();
+            for (int s = 0; s < Chunk::SECTION_COUNT; s++) {
+                const ChunkSection& section = chunk->getSection(s);
+                if (physicalSections.insert(&section).second) sharedBytes += section.memoryUsage();
+                if (section.isEmpty()) emptySections++;
+                else if (section.isUniform()) uniformSections++;
+                bitsHistogram[section.storage().getBitsPerEntry()]++;
+                for (int t = 0; t < BLOCK_TYPE_COUNT; t++) census[t] += section.count(static_cast<BlockType>(t));
+            }
+        }
+        size_t denseBytesPerChunk = static_cast<size_t>(ChunkLayout::VOLUME) * sizeof(Block);
+        size_t paletteBytesPerChunk = paletteBytes / chunkCount;
+        size_t sectionCount = chunkCount * Chunk::SECTION_COUNT;
+
+        std::cout << "Memory report: " << chunkCount << " chunks, " << sectionCount << " sections\n"
+                  << "  dense   : " << denseBytesPerChunk << " B/chunk, "
+                  << denseBytesPerChunk * chunkCount / (1024 * 1024) << " MB total\n"
+                  << "  palette : " << paletteBytesPerChunk << " B/chunk, "
+                  << paletteBytes / 1024 << " KB total ("
+                  << static_cast<float>(denseBytesPerChunk) / paletteBytesPerChunk << "x smaller)\n"
+                  << "  shared  : " << physicalSections.size() << " distinct sections, "
+                  << sharedBytes / 1024 << " KB total\n"
+                  << "  sections all air / uniform: " << emptySections << " / " << uniformSections << "\n"
+                  << "  sections with 0/1/4/8 bits per block: " << bitsHistogram[0] << "/" << bitsHistogram[1] << "/"
+                  << bitsHistogram[4] << "/" << bitsHistogram[8] << std::endl;
+        std::cout << "  blocks :";
+        for (int t = 1; t < BLOCK_TYPE_COUNT; t++) {
+            if (census[t]) std::cout << " " << BLOCK_REGISTRY[t].name << " " << census[t];
+        }
+        std::cout << std::endl;
+        SectionCache::Stats cache = SectionCache::instance().getStats();
+        std::cout << "Section cache: " << cache.uniqueSections << " sections, " << cache.bytes / 1024 << " KB, "
+                  << (cache.lookups ? 100.0f * cache.hits / cache.lookups : 0.0f) << "% hits ("
+                  << cache.lookups << " lookups)" << std::endl;
+        chunkPool.printStats();
+        ChunkColdCache::Stats cold = coldChunks.getStats();
+        std::cout << "Cold tier: " << cold.entries << " chunks, " << cold.bytes / 1024 << " / "
+                  << coldChunks.getCapacity() / 1024 << " KB, " << cold.hits << " hits, " << cold.misses
+                  << " misses, " << cold.evictions << " evicted" << std::endl;
+        std::cout << "Memory budget: " << memoryUsage.total() / (1024 * 1024) << " / " << memoryBudget / (1024 * 1024)
+                  << " MB (blocks " << memoryUsage.blockBytes / (1024 * 1024) << ", meshes "
+                  << memoryUsage.meshBytes / (1024 * 1024) << ", GPU " << memoryUsage.gpuBytes / (1024 * 1024)
+                  << "), " << memoryUsage.evictions << " chunks evicted" << std::endl;
     }
 
-private:
+    void removeBlock(const glm::ivec3& worldPos) {
+        Chunk* chunk = getChunkAt(ChunkLayout::chunkOf(worldPos));
+        if (!chunk) return; // chunk non généré
 
-int divFloor(int x, int size) {
-    return x >= 0 ? x / size : (x - size + 1) / size;
-}
+        glm::ivec3 localPos = ChunkLayout::localOf(worldPos);
+        chunk->setBlockAt(localPos, AIR);
+        remeshNeighboursOf(ChunkLayout::chunkOf(worldPos), localPos);
+    }
 };
@@ -0,0 +1,416 @@
+#include "../include/Benchmark.h"
+#include "../include/Chunk.h"
+#include "../include/ChunkPool.h"
+#include "../include/FlatChunkMap.h"
+#include "../include/ChunkRing.h"
+#include "../include/ChunkSpiral.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+static double elapsedMs(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// Small 4-way LRU cache (4 sets of 64-byte lines, 1 KB) used to count the
+// misses of an access pattern independently of the machine running the benchmark.
+// Smaller than one packed section, otherwise every order fits and gives the same count
+struct SimulatedCache {
+    static constexpr int SETS = 4;
+    static constexpr int WAYS = 4;
+    size_t tags[SETS][WAYS];
+    size_t misses = 0;
+
+    SimulatedCache() {
+        for (auto& set : tags) std::fill(set, set + WAYS, size_t(-1));
+    }
+
+    void access(size_t byteOffset) {
+        size_t line = byteOffset / 64;
+        size_t* set = tags[line % SETS];
+        int hit = WAYS - 1;
+        for (int w = 0; w < WAYS; w++) {
+            if (set[w] == line) { hit = w; break; }
+        }
+        if (set[hit] != line) misses++;
+        // Move to front (most recently used)
+        for (int w = hit; w > 0; w--) set[w] = set[w - 1];
+        set[0] = line;
+    }
+};
+
+// Chunk layer around the average terrain height (~40), so the benchmarks
+// work on the surface whatever the chunk height
+static const int SURFACE_CHUNK_Y = 40 >> ChunkLayout::SHIFT_Y;
+
+// Keeps the benchmark loops from being optimized away
+static volatile size_t benchSink = 0;
+
+// The block order walk works on a fixed 16x128x16 volume (8 sections) whatever
+// the chunk height
+static const int ORDER_VOLUME_HEIGHT = 128;
+static const int ORDER_VOLUME_SECTIONS = ORDER_VOLUME_HEIGHT / ChunkSection::SIZE;
+
+// Visits every block and its 6 neighbours like the mesher does, on sections
+// packed in real PaletteStorage with `Order`, once in storage order and once
+// with the old x->y->z loops. `source` is indexed x + 16 * (z + 16 * y).
+template <typename Order>
+static void benchBlockOrder(const char* name, const std::vector<BlockType>& source) {
+    const glm::ivec3 size(ChunkSection::SIZE, ORDER_VOLUME_HEIGHT, ChunkSection::SIZE);
+    std::vector<PaletteStorage> sections(ORDER_VOLUME_SECTIONS, PaletteStorage(ChunkSection::VOLUME));
+    std::vector<size_t> base(ORDER_VOLUME_SECTIONS); // byte offset of each section's words, laid out one after the other
+    size_t bytes = 0;
+    for (int s = 0; s < ORDER_VOLUME_SECTIONS; s++) {
+        for (int i = 0; i < ChunkSection::VOLUME; i++) {
+            glm::ivec3 p = Order::position(i);
+            sections[s].set(i, source[p.x + size.x * (p.z + size.z * (p.y + s * ChunkSection::SIZE))]);
+        }
+        sections[s].compact();
+        base[s] = bytes;
+        bytes += sections[s].getWords().size() * sizeof(uint64_t);
+    }
+
+    static const glm::ivec3 dirs[6] = {{0,0,1}, {0,0,-1}, {-1,0,0}, {1,0,0}, {0,1,0}, {0,-1,0}};
+    auto read = [&](const glm::ivec3& p, SimulatedCache* cache) {
+        const PaletteStorage& storage = sections[p.y >> ChunkSection::SHIFT];
+        int index = Order::index(p.x, p.y & ChunkSection::MASK, p.z);
+        // Uniform sections keep no words, nothing to fetch
+        if (cache && storage.getBitsPerEntry() > 0) {
+            cache->access(base[p.y >> ChunkSection::SHIFT] + index * storage.getBitsPerEntry() / 8);
+        }
+        return storage.get(index);
+    };
+    auto visit = [&](const glm::ivec3& p, SimulatedCache* cache, size_t& visible) {
+        if (read(p, cache) == AIR) return;
+        for (const auto& d : dirs) {
+            glm::ivec3 n = p + d;
+            if (n.x < 0 || n.y < 0 || n.z < 0 || n.x >= size.x || n.y >= size.y || n.z >= size.z) {
+                visible++;
+                continue;
+            }
+            if (read(n, cache) == AIR) visible++;
+        }
+    };
+
+    auto storageWalk = [&](SimulatedCache* cache, size_t& visible) {
+        for (int s = 0; s < ORDER_VOLUME_SECTIONS; s++) {
+            for (int i = 0; i < ChunkSection::VOLUME; i++) {
+                glm::ivec3 p = Order::position(i);
+                p.y += s * ChunkSection::SIZE;
+                visit(p, cache, visible);
+            }
+        }
+    };
+    auto xyzWalk = [&](SimulatedCache* cache, size_t& visible) {
+        for (int x = 0; x < size.x; x++)
+            for (int y = 0; y < size.y; y++)
+                for (int z = 0; z < size.z; z++)
+                    visit({x, y, z}, cache, visible);
+    };
+
+    const int repeats = 20;
+    const int volume = size.x * size.y * size.z;
+    auto run = [&](const char* walkName, auto walk) {
+        size_t visible = 0;
+        SimulatedCache cache;
+        walk(&cache, visible);
+
+        auto start = BenchClock::now();
+        for (int r = 0; r < repeats; r++) walk(nullptr, visible);
+        double ms = elapsedMs(start) / repeats;
+        benchSink = benchSink + visible;
+
+        std::cout << "  " << name << " / " << walkName << ": "
+                  << ms * 1e6 / volume << " ns/block, "
+                  << cache.misses << " simulated cache misses (" << bytes / 1024 << " KB packed)\n";
+    };
+    run("storage order", storageWalk);
+    run("x->y->z loops", xyzWalk);
+}
+
+static void benchChunkPipeline(siv::PerlinNoise& perlin) {
+    const int chunkCount = 64;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+
+    auto start = BenchClock::now();
+    for (int i = 0; i < chunkCount; i++) {
+        chunks.push_back(std::make_unique<Chunk>(glm::ivec3(i % 8, SURFACE_CHUNK_Y, i / 8)));
+        chunks.back()->generate(perlin);
+    }
+    double generateMs = elapsedMs(start);
+
+    start = BenchClock::now();
+    for (auto& chunk : chunks) chunk->generateMesh();
+    double meshMs = elapsedMs(start);
+
+    std::cout << "  generate: " << generateMs / chunkCount << " ms/chunk\n"
+              << "  mesh    : " << meshMs / chunkCount << " ms/chunk\n";
+}
+
+// Loads and unloads chunks like a player walking in a straight line, with
+// plain allocations and with the ChunkPool
+static void benchChunkStreaming(siv::PerlinNoise& perlin) {
+    const int width = 8;      // chunks loaded across the path
+    const int keptRows = 4;   // rows kept behind the player
+    const int steps = 32;
+
+    auto load = [&](Chunk& chunk) {
+        chunk.generate(perlin);
+        chunk.generateMesh();
+    };
+
+    double allocMs, poolMs;
+    {
+        std::deque<std::unique_ptr<Chunk>> loaded;
+        auto start = BenchClock::now();
+        for (int step = 0; step < steps; step++) {
+            for (int i = 0; i < width; i++) {
+                loaded.push_back(std::make_unique<Chunk>(glm::ivec3(step, SURFACE_CHUNK_Y, i)));
+                load(*loaded.back());
+            }
+            while (loaded.size() > static_cast<size_t>(width * keptRows)) loaded.pop_front();
+        }
+        allocMs = elapsedMs(start) / (width * steps);
+    }
+
+    ChunkPool pool;
+    {
+        std::deque<ChunkHandle> loaded;
+        auto start = BenchClock::now();
+        for (int step = 0; step < steps; step++) {
+            for (int i = 0; i < width; i++) {
+                loaded.push_back(pool.acquire(glm::ivec3(step, SURFACE_CHUNK_Y, i)));
+                load(*pool.get(loaded.back()));
+            }
+            while (loaded.size() > static_cast<size_t>(width * keptRows)) {
+                pool.release(loaded.front());
+                loaded.pop_front();
+            }
+        }
+        poolMs = elapsedMs(start) / (width * steps);
+    }
+    ChunkPool::Stats stats = pool.getStats();
+
+    // Generating and meshing dominate the time, the pool only saves allocations:
+    // without it every chunk and every mesh request (same chunks, same meshing)
+    // is a new object, with its vertex and index vectors grown from empty
+    std::cout << "  make_unique: " << allocMs << " ms/chunk, "
+              << width * steps << " chunks + " << stats.meshRequests << " mesh buffers allocated\n"
+              << "  ChunkPool  : " << poolMs << " ms/chunk, "
+              << stats.chunksAllocated << " chunks + " << stats.meshBuffersAllocated << " mesh buffers allocated ("
+              << 100.0f * stats.chunkHits / stats.chunkRequests << "% chunk hits, "
+              << 100.0f * stats.meshHits / stats.meshRequests << "% mesh buffer hits), peak "
+              << stats.peakFootprintBytes / 1024 << " KB\n";
+}
+
+// Per-block edits against the bulk API on the same boxes
+static void benchBulkEdits() {
+    const int repeats = 200;
+    const glm::ivec3 min(1, 0, 1), max(15, ChunkLayout::SIZE_Y, 15);
+
+    Chunk perBlock(glm::ivec3(0));
+    auto start = BenchClock::now();
+    for (int r = 0; r < repeats; r++) {
+        BlockType type = r % 2 ? STONE : DIRT;
+        for (int z = min.z; z < max.z; z++)
+            for (int y = min.y; y < max.y; y++)
+                for (int x = min.x; x < max.x; x++) perBlock.setBlockAt({x, y, z}, type);
+    }
+    double setMs = elapsedMs(start) / repeats;
+
+    Chunk bulk(glm::ivec3(0));
+    start = BenchClock::now();
+    for (int r = 0; r < repeats; r++) bulk.fillBox(min, max, r % 2 ? STONE : DIRT);
+    double fillMs = elapsedMs(start) / repeats;
+
+    start = BenchClock::now();
+    for (int r = 0; r < repeats; r++) bulk.replaceBlocks(r % 2 ? STONE : DIRT, r % 2 ? DIRT : STONE);
+    double replaceMs = elapsedMs(start) / repeats;
+    benchSink = benchSink + bulk.countBlocks(STONE) + perBlock.countBlocks(STONE);
+
+    std::cout << "  setBlockAt loop: " << setMs * 1000.0 << " us/box\n"
+              << "  fillBox        : " << fillMs * 1000.0 << " us/box\n"
+              << "  replaceBlocks  : " << replaceMs * 1000.0 << " us/chunk\n";
+}
+
+// The chunk map hash before IVec3Hash mixed its input
+struct ShiftXorIVec3Hash {
+    size_t operator()(const glm::ivec3& v) const {
+        return ((std::hash<int>()(v.x) ^ (std::hash<int>()(v.y) << 1)) >> 1) ^ (std::hash<int>()(v.z) << 1);
+    }
+};
+
+// Chunk lookups like the block queries make them: the loaded area is a disk of
+// chunks around the player, 3/4 of the queries hit it and the rest fall just outside
+template <typename Map>
+static double timeChunkLookups(Map& map, const std::vector<glm::ivec3>& queries, int rounds) {
+    auto start = BenchClock::now();
+    size_t found = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (const glm::ivec3& pos : queries) {
+            auto it = map.find(pos);
+            if (it != map.end()) found += it->second.index;
+        }
+    }
+    double ms = elapsedMs(start);
+    benchSink = benchSink + found;
+    return ms * 1e6 / (static_cast<double>(queries.size()) * rounds);
+}
+
+static void benchChunkLookup() {
+    const int radius = 27, vertical = 5, rounds = 20;
+    std::unordered_map<glm::ivec3, ChunkHandle, ShiftXorIVec3Hash> shiftXorMap;
+    std::unordered_map<glm::ivec3, ChunkHandle, IVec3Hash> mixedMap;
+    FlatChunkMap<ChunkHandle> flatMap;
+
+    uint32_t index = 0;
+    for (int x = -radius; x <= radius; x++)
+        for (int z = -radius; z <= radius; z++) {
+            if (x * x + z * z > radius * radius) continue;
+            for (int y = -vertical; y <= vertical; y++) {
+                glm::ivec3 pos(x, SURFACE_CHUNK_Y + y, z);
+                ChunkHandle handle{index++, 1};
+                shiftXorMap[pos] = handle;
+                mixedMap[pos] = handle;
+                flatMap[pos] = handle;
+            }
+        }
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> horizontal(-radius - 6, radius + 6), height(-vertical - 2, vertical + 2);
+    std::vector<glm::ivec3> queries(1 << 16);
+    for (auto& q : queries) q = glm::ivec3(horizontal(rng), SURFACE_CHUNK_Y + height(rng), horizontal(rng));
+
+    size_t largestBucket = 0;
+    for (size_t b = 0; b < shiftXorMap.bucket_count(); b++) largestBucket = std::max(largestBucket, shiftXorMap.bucket_size(b));
+
+    std::cout << "  " << flatMap.size() << " chunks loaded\n"
+              << "  unordered_map, shift/xor hash: " << timeChunkLookups(shiftXorMap, queries, rounds)
+              << " ns/lookup (largest bucket " << largestBucket << ")\n"
+              << "  unordered_map, mixed hash    : " << timeChunkLookups(mixedMap, queries, rounds) << " ns/lookup\n"
+              << "  FlatChunkMap                 : " << timeChunkLookups(flatMap, queries, rounds)
+              << " ns/lookup (" << flatMap.averageProbeLength() << " slots per hit)\n";
+
+    // The ring first, the map outside of its window (slower than the map alone,
+    // World::getChunkAt only uses the map)
+    ChunkRing<ChunkHandle> ring;
+    ring.reset(glm::ivec3(0, SURFACE_CHUNK_Y, 0), radius, vertical);
+    for (const auto& pair : flatMap) ring.set(pair.first, pair.second);
+    auto start = BenchClock::now();
+    size_t found = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (const glm::ivec3& pos : queries) {
+            const ChunkHandle* handle = ring.get(pos);
+            if (!handle && !ring.inWindow(pos)) handle = flatMap.get(pos);
+            if (handle) found += handle->index;
+        }
+    }
+    double ringNs = elapsedMs(start) * 1e6 / (static_cast<double>(queries.size()) * rounds);
+    benchSink = benchSink + found;
+    std::cout << "  ChunkRing, map outside       : " << ringNs << " ns/lookup\n";
+
+    // Out of range chunks after a one-chunk step, like unloadFarChunks
+    const int steps = 200;
+    size_t leaving = 0;
+    start = BenchClock::now();
+    for (int i = 0; i < steps; i++) {
+        glm::ivec3 center(i % 2, SURFACE_CHUNK_Y, 0);
+        for (const auto& pair : flatMap) {
+            glm::ivec3 d = pair.first - center;
+            if (std::abs(d.x) > radius || std::abs(d.z) > radius || std::abs(d.y) > vertical) leaving++;
+        }
+    }
+    double scanUs = elapsedMs(start) * 1000.0 / steps;
+    std::vector<std::pair<glm::ivec3, ChunkHandle>> slab;
+    start = BenchClock::now();
+    for (int i = 0; i < steps; i++) {
+        // Steps back and forth, the slab that leaves comes back in on the other side
+        glm::ivec3 center((i + 1) % 2, SURFACE_CHUNK_Y, 0);
+        glm::ivec3 across((2 * center.x - 1) * (2 * radius + 1), 0, 0);
+        slab.clear();
+        ring.recenter(center, [&](const glm::ivec3& pos, const ChunkHandle& handle) {
+            slab.push_back({pos + across, handle});
+        });
+        leaving += slab.size();
+        for (const auto& entry : slab) ring.set(entry.first, entry.second);
+    }
+    double sweepUs = elapsedMs(start) * 1000.0 / steps;
+    benchSink = benchSink + leaving;
+    std::cout << "  out of range after a step: map scan " << scanUs << " us, ring edge sweep " << sweepUs << " us\n";
+}
+
+// Chunks to draw around the player every frame: the vector built with a
+// distance test per column against the precomputed spiral
+static void benchViewList() {
+    const int viewDistance = 20, vertical = 4, frames = 500;
+    size_t visited = 0;
+    auto start = BenchClock::now();
+    for (int f = 0; f < frames; f++) {
+        glm::ivec3 center(f, SURFACE_CHUNK_Y, 0);
+        std::vector<glm::ivec3> list;
+        for (int x = -viewDistance; x <= viewDistance; x++)
+            for (int z = -viewDistance; z <= viewDistance; z++) {
+                if (glm::length(glm::vec2(x, z)) > viewDistance) continue;
+                for (int y = -vertical; y <= vertical; y++) list.push_back(center + glm::ivec3(x, y, z));
+            }
+        for (const glm::ivec3& pos : list) visited += pos.x & 1;
+    }
+    double buildUs = elapsedMs(start) * 1000.0 / frames;
+
+    start = BenchClock::now();
+    ChunkSpiral spiral(viewDistance, vertical);
+    double tableUs = elapsedMs(start) * 1000.0;
+    start = BenchClock::now();
+    for (int f = 0; f < frames; f++) {
+        for (const glm::ivec3& pos : spiral.around(glm::ivec3(f, SURFACE_CHUNK_Y, 0))) visited += pos.x & 1;
+    }
+    double spiralUs = elapsedMs(start) * 1000.0 / frames;
+    benchSink = benchSink + visited;
+    std::cout << "  " << spiral.size() << " chunks: vector per frame " << buildUs << " us, spiral " << spiralUs
+              << " us (table built once in " << tableUs << " us)\n";
+}
+
+int runBenchmarks() {
+    siv::PerlinNoise perlin(12345);
+
+    std::cout << "Chunk pipeline (" << ChunkLayout::SIZE_X << "x" << ChunkLayout::SIZE_Y << "x"
+              << ChunkLayout::SIZE_Z << ", block order " << int(SectionOrder::ID) << ")\n";
+    benchChunkPipeline(perlin);
+
+    std::cout << "Chunk streaming (load, mesh, unload)\n";
+    benchChunkStreaming(perlin);
+
+    std::cout << "Bulk edits (" << (14 * 14 * ChunkLayout::SIZE_Y) << " blocks)\n";
+    benchBulkEdits();
+
+    std::cout << "Chunk map lookups\n";
+    benchChunkLookup();
+
+    std::cout << "View list\n";
+    benchViewList();
+
+    // Real terrain as the data to walk through: the chunks of the bottom 128 blocks
+    std::vector<BlockType> types(ChunkSection::SIZE * ORDER_VOLUME_HEIGHT * ChunkSection::SIZE);
+    for (int cy = 0; cy * ChunkLayout::SIZE_Y < ORDER_VOLUME_HEIGHT; cy++) {
+        Chunk sample(glm::ivec3(0, cy, 0));
+        sample.generate(perlin);
+        for (int i = 0; i < ChunkLayout::VOLUME; i++) {
+            glm::ivec3 p = Chunk::localPosOf(i);
+            int y = p.y + cy * ChunkLayout::SIZE_Y;
+            if (y < ORDER_VOLUME_HEIGHT) types[p.x + ChunkSection::SIZE * (p.z + ChunkSection::SIZE * y)] = sample.getBlockAt(p).type;
+        }
+    }
+
+    std::cout << "Block order walk (block + 6 neighbours)\n";
+    benchBlockOrder<XYZOrder>("x innermost", types);
+    benchBlockOrder<YZXOrder>("y innermost", types);
+    benchBlockOrder<MortonOrder>("morton     ", types);
+    return 0;
+}
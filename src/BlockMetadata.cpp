@@ -0,0 +1,94 @@
+#include "../include/BlockMetadata.h"
+#include <algorithm>
+#include <iostream>
+
+std::vector<BlockMetadata::Entry>::iterator BlockMetadata::find(uint32_t index) {
+    return std::lower_bound(entries.begin(), entries.end(), index,
+                            [](const Entry& e, uint32_t i) { return e.index < i; });
+}
+
+std::vector<BlockMetadata::Entry>::const_iterator BlockMetadata::find(uint32_t index) const {
+    return std::lower_bound(entries.begin(), entries.end(), index,
+                            [](const Entry& e, uint32_t i) { return e.index < i; });
+}
+
+const BlockData* BlockMetadata::get(uint32_t index) const {
+    auto it = find(index);
+    if (it == entries.end() || it->index != index) return nullptr;
+    return &it->data;
+}
+
+bool BlockMetadata::set(uint32_t index, BlockData data) {
+    if (data.payload.size() > MAX_PAYLOAD_SIZE) {
+        std::cerr << "Block data payload too big: " << data.payload.size() << " bytes (max "
+                  << MAX_PAYLOAD_SIZE << ")\n";
+        return false;
+    }
+    auto it = find(index);
+    if (it != entries.end() && it->index == index) {
+        it->data = std::move(data);
+    } else {
+        entries.insert(it, Entry{index, std::move(data)});
+    }
+    return true;
+}
+
+bool BlockMetadata::erase(uint32_t index) {
+    auto it = find(index);
+    if (it == entries.end() || it->index != index) return false;
+    entries.erase(it);
+    return true;
+}
+
+
+void BlockMetadata::write(std::ostream& out) const {
+    uint32_t count = static_cast<uint32_t>(entries.size());
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const Entry& entry : entries) {
+        uint16_t payloadSize = static_cast<uint16_t>(entry.data.payload.size()); // bounded by set()
+        out.write(reinterpret_cast<const char*>(&entry.index), sizeof(entry.index));
+        out.write(reinterpret_cast<const char*>(&entry.data.value), sizeof(entry.data.value));
+        out.write(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+        out.write(reinterpret_cast<const char*>(entry.data.payload.data()), payloadSize);
+    }
+}
+
+bool BlockMetadata::read(std::istream& in, uint32_t maxIndex) {
+    uint32_t count = 0;
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || count > maxIndex) {
+        std::cerr << "Corrupted file: invalid metadata count=" << count << "\n";
+        return false;
+    }
+
+    std::vector<Entry> loaded;
+    loaded.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Entry entry;
+        uint16_t payloadSize = 0;
+        in.read(reinterpret_cast<char*>(&entry.index), sizeof(entry.index));
+        in.read(reinterpret_cast<char*>(&entry.data.value), sizeof(entry.data.value));
+        in.read(reinterpret_cast<char*>(&payloadSize), sizeof(payloadSize));
+        entry.data.payload.resize(payloadSize);
+        in.read(reinterpret_cast<char*>(entry.data.payload.data()), payloadSize);
+        if (!in) {
+            std::cerr << "Corrupted file: premature EOF while reading metadata\n";
+            return false;
+        }
+        // Written sorted, anything else is corrupted
+        if (entry.index >= maxIndex || (!loaded.empty() && entry.index <= loaded.back().index)) {
+            std::cerr << "Corrupted file: invalid metadata index=" << entry.index << "\n";
+            return false;
+        }
+        loaded.push_back(std::move(entry));
+    }
+    entries = std::move(loaded);
+    return true;
+}
+
+
+size_t BlockMetadata::memoryUsage() const {
+    size_t total = sizeof(*this) + entries.capacity() * sizeof(Entry);
+    for (const Entry& entry : entries) total += entry.data.payload.capacity();
+    return total;
+}
@@ -1,28 +1,15 @@
 #include "../include/Chunk.h"
+#include "../include/ChunkPool.h"
+#include "../include/SectionCache.h"
+#include "../include/ChunkNeighborhood.h"
 #include "../include/PerlinNoise.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
-#include <map>
 #include <time.h>
 #include <fstream>
 #include <set>
-
-// Block texture is
-// {front, back, left, right, top, bottom}
-static std::map<BlockType, BlockTexture> blockTextures = {
-    {DIRT, {0, 0, 0, 0, 0, 0}},
-    {GRASS, {1, 1, 1, 1, 2, 0}},
-    {STONE, {3, 3, 3, 3, 3, 3}},
-    {WOOD, {6, 6, 6, 6, 7, 7}},
-    {LEAF, {5, 5, 5, 5, 5, 5}},
-    {SAND, {4, 4, 4, 4, 4, 4}},
-    {PUMPKIN, {8, 9, 9, 9, 9, 10}},
-    {SNOW, {11, 11, 11, 11, 11, 11}},
-    {COBBLESTONE, {12, 12, 12, 12, 12, 12}},
-    {BRICK, {13, 13, 13, 13, 13, 13}},
-    {PLANKS, {14, 14, 14, 14, 14, 14}},
-    {IRON_ORE, {15, 15, 15, 15, 15, 15}},
-};
+#include <unordered_map>
 
 enum Biomes {
     PLAINS,
@@ -33,15 +20,23 @@ enum Biomes {
     SWAMP
 };
 
-const glm::ivec3 Chunk::CHUNK_SIZE = glm::ivec3(16, 128, 16);
-
-
 void Chunk::generate(siv::PerlinNoise& perlin) {
-    meshPositions.reserve(Chunk::CHUNK_SIZE.x * Chunk::CHUNK_SIZE.y * Chunk::CHUNK_SIZE.z * 6);
-    meshFaces.reserve(Chunk::CHUNK_SIZE.x * Chunk::CHUNK_SIZE.y * Chunk::CHUNK_SIZE.z * 6);
-    meshTypes.reserve(Chunk::CHUNK_SIZE.x * Chunk::CHUNK_SIZE.y * Chunk::CHUNK_SIZE.z * 6);
-    blocks.resize(Chunk::CHUNK_SIZE.x * Chunk::CHUNK_SIZE.y * Chunk::CHUNK_SIZE.z, {{0,0,0}, AIR});
-
+    const int baseY = chunkPos.y * Chunk::CHUNK_SIZE.y;
+    // Written straight into the sections rather than through setBlockAt/fillBox:
+    // a new chunk has no block data, and the height map and the version are
+    // updated once at the end instead of for every column
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    auto setBlock = [this](const glm::ivec3& p, BlockType type) {
+        editSection(p.y >> ChunkSection::SHIFT).set(p.x, p.y & ChunkSection::MASK, p.z, type);
+    };
+    auto fillBlocks = [this](int x, int z, int yBegin, int yEnd, BlockType type) {
+        for (int y = yBegin; y < yEnd;) {
+            const int s = y >> ChunkSection::SHIFT;
+            const int end = std::min(yEnd, (s + 1) * ChunkSection::SIZE);
+            editSection(s).fillColumn(x, z, y & ChunkSection::MASK, end - s * ChunkSection::SIZE, type);
+            y = end;
+        }
+    };
     for (int x = 0; x < Chunk::CHUNK_SIZE.x; x++) {
         int worldX = x + chunkPos.x * Chunk::CHUNK_SIZE.x;
 
@@ -70,187 +65,541 @@ void Chunk::generate(siv::PerlinNoise& perlin) {
                 biome = MOUNTAINS;
             else
                 biome = PLAINS;
-            for (int y = 0; y < Chunk::CHUNK_SIZE.y; y++) {
-                if (y > elevation) continue;
-                // Place top block based on biome
-                if (y == elevation) {
-                    switch (biome) {
-                        case PLAINS:
-                            setBlockAt({x, y, z}, GRASS);
-                            break;
-                        case DESERT:
-                            setBlockAt({x, y, z}, SAND);
-                            break;
-                        case FOREST:
-                            // Add wooden planks occasionally in forest areas
-                            if (forestNoise > 0.9f) {
-                                setBlockAt({x, y, z}, PLANKS);
-                            } else {
-                                setBlockAt({x, y, z}, GRASS);
-                            }
-                            break;
-                        case MOUNTAINS:
-                            // Add some architectural variety to mountains
-                            if (mountainNoise > 0.8f) {
-                                setBlockAt({x, y, z}, BRICK);
-                            } else if (mountainNoise > 0.7f) {
-                                setBlockAt({x, y, z}, COBBLESTONE);
-                            } else {
-                                setBlockAt({x, y, z}, STONE);
-                            }
-                            break;
-                        case SNOWY:
-                            setBlockAt({x, y, z}, SNOW);
-                            break;
-                        case SWAMP:
-                            setBlockAt({x, y, z}, GRASS);
-                            break;
-                        default:
-                            setBlockAt({x, y, z}, GRASS);
-                            break;
-                    }
+            // Local y of the surface and of the top of the deep layer, clamped to the chunk
+            auto localY = [baseY](int worldY) {
+                return std::min(std::max(worldY - baseY, 0), Chunk::CHUNK_SIZE.y);
+            };
+            const int deepEnd = localY(elevation - 4);
+            const int subsurfaceEnd = localY(elevation);
+
+            // Deep underground blocks: stone, then ore deposits using noise.
+            // No deposit above y 50, no need for the noise there
+            fillBlocks(x, z, 0, deepEnd, STONE);
+            for (int y = 0; y < std::min(deepEnd, localY(50)); y++) {
+                const int worldY = baseY + y;
+                float oreNoise = perlin.octave3D_01(worldX * 0.05f, worldY * 0.05f, worldZ * 0.05f, 4);
+                
+                if (oreNoise > 0.7f && worldY < 30) {
+                    // Iron ore deposits at lower depths
+                    setBlock({x, y, z}, IRON_ORE);
+                } else if (oreNoise > 0.8f && worldY < 50) {
+                    // Cobblestone patches in mid-depths  
+                    setBlock({x, y, z}, COBBLESTONE);
                 }
-                // Place sub-surface blocks
-                else if (y >= elevation - 4) {
-                    switch (biome) {
-                        case PLAINS:
-                        case FOREST:
-                        case SWAMP:
-                            setBlockAt({x, y, z}, DIRT);
-                            break;
-                        case DESERT:
-                            setBlockAt({x, y, z}, SAND);
-                            break;
-                        case MOUNTAINS:
-                        case SNOWY:
-                            setBlockAt({x, y, z}, STONE);
-                            break;
-                        default:
-                            setBlockAt({x, y, z}, DIRT);
-                            break;
+            }
+
+            // Place sub-surface blocks
+            BlockType subsurface;
+            switch (biome) {
+                case DESERT:
+                    subsurface = SAND;
+                    break;
+                case MOUNTAINS:
+                case SNOWY:
+                    subsurface = STONE;
+                    break;
+                default:
+                    subsurface = DIRT;
+                    break;
+            }
+            fillBlocks(x, z, deepEnd, subsurfaceEnd, subsurface);
+
+            // Place top block based on biome
+            const int y = elevation - baseY;
+            if (y < 0 || y >= Chunk::CHUNK_SIZE.y) continue;
+            switch (biome) {
+                case PLAINS:
+                    setBlock({x, y, z}, GRASS);
+                    break;
+                case DESERT:
+                    setBlock({x, y, z}, SAND);
+                    break;
+                case FOREST:
+                    // Add wooden planks occasionally in forest areas
+                    if (forestNoise > 0.9f) {
+                        setBlock({x, y, z}, PLANKS);
+                    } else {
+                        setBlock({x, y, z}, GRASS);
                     }
-                }
-                // Deep underground blocks
-                else {
-                    // Generate ore deposits using noise
-                    float oreNoise = perlin.octave3D_01(worldX * 0.05f, y * 0.05f, worldZ * 0.05f, 4);
-                    
-                    if (oreNoise > 0.7f && y < 30) {
-                        // Iron ore deposits at lower depths
-                        setBlockAt({x, y, z}, IRON_ORE);
-                    } else if (oreNoise > 0.8f && y < 50) {
-                        // Cobblestone patches in mid-depths  
-                        setBlockAt({x, y, z}, COBBLESTONE);
+                    break;
+                case MOUNTAINS:
+                    // Add some architectural variety to mountains
+                    if (mountainNoise > 0.8f) {
+                        setBlock({x, y, z}, BRICK);
+                    } else if (mountainNoise > 0.7f) {
+                        setBlock({x, y, z}, COBBLESTONE);
                     } else {
-                        setBlockAt({x, y, z}, STONE);
+                        setBlock({x, y, z}, STONE);
                     }
-                }
+                    break;
+                case SNOWY:
+                    setBlock({x, y, z}, SNOW);
+                    break;
+                case SWAMP:
+                    setBlock({x, y, z}, GRASS);
+                    break;
+                default:
+                    setBlock({x, y, z}, GRASS);
+                    break;
             }
         }
     }
+
+    // Sections left with a single type (air above the terrain, plain stone
+    // below) collapse to one value, then identical sections get shared.
+    // The untouched ones are still the shared air section, nothing to do.
+    for (auto& section : sections) {
+        if (section.use_count() == 1) {
+            section->compact();
+            section = SectionCache::instance().intern(section);
+        }
+    }
+    rebuildHeightMap();
+    version++;
+}
+
+
+size_t Chunk::releasableMemoryUsage() const {
+    size_t total = ownedMemoryUsage();
+    const SectionCache& cache = SectionCache::instance();
+    for (const auto& section : sections) {
+        // Two references can also be this chunk and a worker snapshot, which
+        // keeps the section alive: only count the ones held by the cache
+        if (section.use_count() == 2 && cache.contains(section)) total += section->memoryUsage();
+    }
+    return total;
+}
+
+
+// All air, sharing the cached empty section until the first edit
+Chunk::SectionArray Chunk::makeSections() {
+    SectionArray result;
+    for (auto& section : result) section = SectionCache::instance().uniform(AIR);
+    return result;
+}
+
+
+ChunkSection& Chunk::editSection(int s) {
+    // Shared with a snapshot, another chunk or the SectionCache. The count can only
+    // be too high (a snapshot dropped meanwhile), never too low: new references
+    // to a section this chunk owns alone are only taken by snapshot() under the same lock
+    if (sections[s].use_count() > 1) {
+        sections[s] = std::make_shared<ChunkSection>(*sections[s]);
+    }
+    return *sections[s];
+}
+
+
+void Chunk::installSections(const glm::ivec3& pos, SectionArray&& loaded, std::shared_ptr<BlockMetadata> loadedMetadata) {
+    for (auto& section : loaded) section = SectionCache::instance().intern(section);
+    if (loadedMetadata && loadedMetadata->empty()) loadedMetadata.reset();
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    chunkPos = pos;
+    sections = std::move(loaded);
+    metadata = std::move(loadedMetadata);
+    rebuildHeightMap();
+    version++;
+    savedVersion = version.load(); // same content as the file
+}
+
+
+ChunkSnapshot Chunk::snapshot() const {
+    ChunkSnapshot snap;
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    snap.version = version.load();
+    snap.chunkPos = chunkPos;
+    for (int s = 0; s < SECTION_COUNT; s++) snap.sections[s] = sections[s];
+    snap.metadata = metadata;
+    snap.heightMap = heightMap;
+    snap.minY = minOccupiedY;
+    snap.maxY = maxOccupiedY;
+    return snap;
 }
 
 
 void Chunk::setBlockAt(const glm::ivec3& localPos, BlockType type) {
-    int index = localPos.x 
-              + localPos.y * CHUNK_SIZE.x
-              + localPos.z * CHUNK_SIZE.x * CHUNK_SIZE.y;
-    blocks[index].type = type;
-    blocks[index].position = glm::vec3(localPos);
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    const int sectionY = localPos.y >> ChunkSection::SHIFT;
+    ChunkSection& section = editSection(sectionY);
+    int sectionIndex = ChunkSection::indexOf(localPos.x, localPos.y & ChunkSection::MASK, localPos.z);
+    if (metadata && section.get(sectionIndex) != type) {
+        // The data belonged to the block being replaced
+        uint32_t index = static_cast<uint32_t>(indexOf(localPos));
+        if (metadata->get(index)) {
+            editMetadata().erase(index);
+            if (metadata->empty()) metadata.reset();
+        }
+    }
+    section.set(sectionIndex, type);
+    version++;
+
+    int16_t& top = heightMap[localPos.x + localPos.z * CHUNK_SIZE.x];
+    if (type != AIR) {
+        if (localPos.y >= top) top = static_cast<int16_t>(localPos.y + 1);
+        minOccupiedY = std::min(minOccupiedY, localPos.y);
+        maxOccupiedY = std::max(maxOccupiedY, localPos.y);
+        return;
+    }
+
+    if (localPos.y + 1 != top) return; // not the top of the column
+    // The top block was removed: look for the next one down
+    int y = -1;
+    for (int s = sectionY; s >= 0; s--) {
+        uint32_t column = sections[s]->occupiedColumn(localPos.x, localPos.z);
+        if (column) {
+            y = s * ChunkSection::SIZE + highestBit(column);
+            break;
+        }
+    }
+    top = static_cast<int16_t>(y + 1);
+
+    if (localPos.y == maxOccupiedY) {
+        maxOccupiedY = *std::max_element(heightMap.begin(), heightMap.end()) - 1;
+    }
+}
+
+
+int Chunk::getHighestBlockAt(int localX, int localZ, int maxLocalY) const {
+    if (maxLocalY >= CHUNK_SIZE.y - 1) return getHighestBlockAt(localX, localZ);
+    for (int s = maxLocalY >> ChunkSection::SHIFT; s >= 0; s--) {
+        uint32_t column = sections[s]->occupiedColumn(localX, localZ);
+        if (s == maxLocalY >> ChunkSection::SHIFT) {
+            column &= (2u << (maxLocalY & ChunkSection::MASK)) - 1; // drop the blocks above maxLocalY
+        }
+        if (column) return s * ChunkSection::SIZE + highestBit(column);
+    }
+    return -1;
+}
+
+
+int Chunk::findColumnTop(int localX, int localZ) const {
+    for (int s = SECTION_COUNT - 1; s >= 0; s--) {
+        uint32_t column = sections[s]->occupiedColumn(localX, localZ);
+        if (column) return s * ChunkSection::SIZE + highestBit(column);
+    }
+    return -1;
+}
+
+
+template <typename Predicate>
+void Chunk::eraseBlockDataIf(Predicate drop) {
+    if (!metadata) return;
+    std::vector<uint32_t> dropped;
+    for (const BlockMetadata::Entry& entry : metadata->getEntries()) {
+        glm::ivec3 p = localPosOf(static_cast<int>(entry.index));
+        BlockType type = sections[p.y >> ChunkSection::SHIFT]->get(p.x, p.y & ChunkSection::MASK, p.z);
+        if (drop(p, type)) dropped.push_back(entry.index);
+    }
+    if (dropped.empty()) return;
+    BlockMetadata& edited = editMetadata();
+    for (uint32_t index : dropped) edited.erase(index);
+    if (metadata->empty()) metadata.reset();
+}
+
+
+void Chunk::fillBox(const glm::ivec3& min, const glm::ivec3& max, BlockType type) {
+    const glm::ivec3 lo = glm::max(min, glm::ivec3(0));
+    const glm::ivec3 hi = glm::min(max, CHUNK_SIZE);
+    if (lo.x >= hi.x || lo.y >= hi.y || lo.z >= hi.z) return;
+
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    eraseBlockDataIf([&](const glm::ivec3& p, BlockType old) {
+        return old != type && p.x >= lo.x && p.y >= lo.y && p.z >= lo.z
+                           && p.x < hi.x && p.y < hi.y && p.z < hi.z;
+    });
+    for (int s = lo.y >> ChunkSection::SHIFT; s <= (hi.y - 1) >> ChunkSection::SHIFT; s++) {
+        const int base = s * ChunkSection::SIZE;
+        glm::ivec3 sectionMin(lo.x, std::max(lo.y - base, 0), lo.z);
+        glm::ivec3 sectionMax(hi.x, std::min(hi.y - base, ChunkSection::SIZE), hi.z);
+        if (sectionMin == glm::ivec3(0) && sectionMax == glm::ivec3(ChunkSection::SIZE)) {
+            sections[s] = SectionCache::instance().uniform(type); // copied on the next edit
+        } else {
+            editSection(s).fillBox(sectionMin, sectionMax, type);
+        }
+    }
+    version++;
+
+    // Only the columns of the box can change height
+    for (int z = lo.z; z < hi.z; z++) {
+        for (int x = lo.x; x < hi.x; x++) {
+            int16_t& top = heightMap[x + z * CHUNK_SIZE.x];
+            if (type != AIR) {
+                top = static_cast<int16_t>(std::max<int>(top, hi.y));
+            } else if (top > lo.y && top <= hi.y) {
+                top = static_cast<int16_t>(findColumnTop(x, z) + 1);
+            }
+        }
+    }
+    if (type != AIR) {
+        minOccupiedY = std::min(minOccupiedY, lo.y);
+        maxOccupiedY = std::max(maxOccupiedY, hi.y - 1);
+    } else {
+        maxOccupiedY = *std::max_element(heightMap.begin(), heightMap.end()) - 1;
+    }
+}
+
+
+void Chunk::setBlocks(const BlockEdit* edits, size_t count) {
+    if (count == 0) return;
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    // Columns whose top block may have been removed, looked up again at the end
+    std::array<bool, CHUNK_SIZE.x * CHUNK_SIZE.z> lostTop{};
+    bool removed = false;
+    for (size_t i = 0; i < count; i++) {
+        const glm::ivec3& localPos = edits[i].pos;
+        const BlockType type = edits[i].type;
+        ChunkSection& section = editSection(localPos.y >> ChunkSection::SHIFT);
+        int sectionIndex = ChunkSection::indexOf(localPos.x, localPos.y & ChunkSection::MASK, localPos.z);
+        if (metadata && section.get(sectionIndex) != type) {
+            uint32_t index = static_cast<uint32_t>(indexOf(localPos));
+            if (metadata->get(index)) {
+                editMetadata().erase(index);
+                if (metadata->empty()) metadata.reset();
+            }
+        }
+        section.set(sectionIndex, type);
+
+        const int column = localPos.x + localPos.z * CHUNK_SIZE.x;
+        int16_t& top = heightMap[column];
+        if (type != AIR) {
+            if (localPos.y >= top) top = static_cast<int16_t>(localPos.y + 1);
+            minOccupiedY = std::min(minOccupiedY, localPos.y);
+            maxOccupiedY = std::max(maxOccupiedY, localPos.y);
+        } else if (localPos.y + 1 == top) {
+            lostTop[column] = true;
+            removed = true;
+        }
+    }
+    version++;
+
+    if (!removed) return;
+    for (int column = 0; column < CHUNK_SIZE.x * CHUNK_SIZE.z; column++) {
+        if (lostTop[column]) {
+            heightMap[column] = static_cast<int16_t>(findColumnTop(column % CHUNK_SIZE.x, column / CHUNK_SIZE.x) + 1);
+        }
+    }
+    maxOccupiedY = *std::max_element(heightMap.begin(), heightMap.end()) - 1;
+}
+
+
+int Chunk::replaceBlocks(BlockType from, BlockType to) {
+    if (from == to) return 0;
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    eraseBlockDataIf([from](const glm::ivec3&, BlockType type) { return type == from; });
+
+    int changed = 0;
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        int n = sections[s]->count(from);
+        if (n == 0) continue;
+        changed += n;
+        if (n == ChunkSection::VOLUME) {
+            sections[s] = SectionCache::instance().uniform(to);
+        } else {
+            editSection(s).replace(from, to);
+        }
+    }
+    if (changed == 0) return 0;
+    version++;
+    if (from == AIR || to == AIR) rebuildHeightMap();
+    return changed;
+}
+
+
+void Chunk::rebuildHeightMap() {
+    minOccupiedY = CHUNK_SIZE.y;
+    maxOccupiedY = -1;
+
+    for (int x = 0; x < CHUNK_SIZE.x; x++) {
+        for (int z = 0; z < CHUNK_SIZE.z; z++) {
+            int top = findColumnTop(x, z);
+            int bottom = CHUNK_SIZE.y;
+            // Lowest block, only needed for the chunk-wide bound
+            for (int s = 0; s < SECTION_COUNT && top >= 0; s++) {
+                uint32_t column = sections[s]->occupiedColumn(x, z);
+                if (column) {
+                    bottom = s * ChunkSection::SIZE + lowestBit(column);
+                    break;
+                }
+            }
+
+            heightMap[x + z * CHUNK_SIZE.x] = static_cast<int16_t>(top + 1);
+            if (top >= 0) {
+                minOccupiedY = std::min(minOccupiedY, bottom);
+                maxOccupiedY = std::max(maxOccupiedY, top);
+            }
+        }
+    }
 }
 
 
-Block& Chunk::getBlockAt(const glm::ivec3& localPos) {
+// Edits only happen on the main thread, so readers there don't need the lock
+Block Chunk::getBlockAt(const glm::ivec3& localPos) const {
     // Out of bounds check
-    if (localPos.x < 0 || localPos.x >= CHUNK_SIZE.x ||
-        localPos.y < 0 || localPos.y >= CHUNK_SIZE.y ||
-        localPos.z < 0 || localPos.z >= CHUNK_SIZE.z) {
-        static Block airBlock = {{0,0,0}, AIR};
-        return airBlock; // Return a reference to a static AIR block
+    if (!ChunkLayout::contains(localPos)) {
+        return {AIR};
     }
-    int index = localPos.x 
-              + localPos.y * CHUNK_SIZE.x
-              + localPos.z * CHUNK_SIZE.x * CHUNK_SIZE.y;
-    return blocks[index];
+    return {sections[localPos.y >> ChunkSection::SHIFT]->get(
+        ChunkSection::indexOf(localPos.x, localPos.y & ChunkSection::MASK, localPos.z))};
+}
+
+
+BlockMetadata& Chunk::editMetadata() {
+    if (!metadata) {
+        metadata = std::make_shared<BlockMetadata>();
+    } else if (metadata.use_count() > 1) {
+        metadata = std::make_shared<BlockMetadata>(*metadata);
+    }
+    return *metadata;
+}
+
+
+const BlockData* Chunk::getBlockData(const glm::ivec3& localPos) const {
+    if (!metadata || !ChunkLayout::contains(localPos)) return nullptr;
+    return metadata->get(static_cast<uint32_t>(indexOf(localPos)));
+}
+
+
+bool Chunk::setBlockData(const glm::ivec3& localPos, BlockData data) {
+    if (!ChunkLayout::contains(localPos)) return false;
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    if (!editMetadata().set(static_cast<uint32_t>(indexOf(localPos)), std::move(data))) {
+        if (metadata->empty()) metadata.reset();
+        return false;
+    }
+    version++;
+    return true;
+}
+
+
+void Chunk::clearBlockData(const glm::ivec3& localPos) {
+    if (!metadata || !ChunkLayout::contains(localPos)) return;
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    uint32_t index = static_cast<uint32_t>(indexOf(localPos));
+    if (!metadata->get(index)) return;
+    editMetadata().erase(index);
+    if (metadata->empty()) metadata.reset();
+    version++;
+}
+
+
+BlockRef Chunk::getBlockRef(const glm::ivec3& localPos) const {
+    int index = indexOf(localPos);
+    return {this, index, getBlockAt(localPos).type};
 }
 
 
 void Chunk::generateMesh() {
-    busy = true;
-    vertices.clear();
-    indices.clear();
-
-    vertices.reserve(blocks.size() * 24); // max 24 vertices per block
-    indices.reserve(blocks.size() * 36);  // max 36 indices per block
-
-    meshPositions.clear();
-    meshFaces.clear();
-    meshTypes.clear();
-    meshPositions.reserve(blocks.size() * 6); // max 6 faces per block
-    meshFaces.reserve(blocks.size() * 6);
-    meshTypes.reserve(blocks.size() * 6);
-
-
-    //for (const auto& block : blocks) {
-    for (int x = 0; x < CHUNK_SIZE.x; ++x) {
-        for (int y = 0; y < CHUNK_SIZE.y; ++y) {
-            for (int z = 0; z < CHUNK_SIZE.z; ++z) {
-                Block& block = getBlockAt(glm::ivec3(x,y,z));
-                BlockType type = block.type;
-                glm::ivec3 localPos = glm::ivec3(x,y,z);
-                glm::ivec3 worldPos = localPos + chunkPos * CHUNK_SIZE;
-                if (type == AIR) continue;
-
-                // Check each face
-                // FRONT (+Z)
-                if (getBlockAt(localPos + glm::ivec3(0, 0, 1)).type == AIR) {
-                    meshPositions.push_back(worldPos);
-                    meshFaces.push_back(FRONT);
-                    meshTypes.push_back(type);
-                }
-                // BACK (-Z)
-                if (getBlockAt(localPos + glm::ivec3(0, 0, -1)).type == AIR) {
-                    meshPositions.push_back(worldPos);
-                    meshFaces.push_back(BACK);
-                    meshTypes.push_back(type);
-                }
-                // LEFT (-X)
-                if (getBlockAt(localPos + glm::ivec3(-1, 0, 0)).type == AIR) {
-                    meshPositions.push_back(worldPos);
-                    meshFaces.push_back(LEFT);
-                    meshTypes.push_back(type);
-                }
-                // RIGHT (+X)
-                if (getBlockAt(localPos + glm::ivec3(1, 0, 0)).type == AIR) {
-                    meshPositions.push_back(worldPos);
-                    meshFaces.push_back(RIGHT);
-                    meshTypes.push_back(type);
-                }
-                // TOP (+Y)
-                if (getBlockAt(localPos + glm::ivec3(0, 1, 0)).type == AIR) {
-                    meshPositions.push_back(worldPos);
-                    meshFaces.push_back(TOP);
-                    meshTypes.push_back(type);
-                }
-                // BOTTOM (-Y)
-                if (getBlockAt(localPos + glm::ivec3(0, -1, 0)).type == AIR) {
-                    meshPositions.push_back(worldPos);
-                    meshFaces.push_back(BOTTOM);
-                    meshTypes.push_back(type);
+    // No neighbours: the border reads as air. Per thread, so the buffers are reused.
+    static thread_local ChunkNeighborhood hood;
+    hood.build(*this, {});
+    generateMesh(hood);
+}
+
+
+void Chunk::generateMesh(const ChunkNeighborhood& hood) {
+    // Recycled buffers: they keep the capacity of the previous meshes
+    std::unique_ptr<MeshBuffers> buffers = acquireMesh();
+    MeshBuffers& m = *buffers;
+    m.vertices.clear();
+    m.indices.clear();
+    m.positions.clear();
+    m.faces.clear();
+    m.types.clear();
+
+    // Nothing to mesh outside of the occupied range
+    const int firstSection = std::max(hood.getMinY(), 0) >> ChunkSection::SHIFT;
+    const int lastSection = hood.getMaxY() >> ChunkSection::SHIFT;
+    const int S = ChunkSection::SIZE;
+    const int H = CHUNK_SIZE.y;
+
+    // A face of an opaque block is visible where its neighbour isn't opaque:
+    // whole columns of 16 blocks are tested at once. The neighbourhood has the
+    // masks of the columns around the chunk, only the top and bottom of the
+    // chunk need the padded blocks.
+    for (int s = firstSection; s <= lastSection; ++s) {
+        if (hood.isSectionEmpty(s)) continue; // nothing to draw in an all-air section
+
+        for (int z = 0; z < S; ++z) {
+            for (int x = 0; x < S; ++x) {
+                uint32_t column = hood.opaqueColumn(s, x, z);
+                if (!column) continue;
+
+                uint32_t above = s + 1 < SECTION_COUNT ? hood.opaqueColumn(s + 1, x, z) & 1 : hood.isOpaque(x, H, z);
+                uint32_t below = s > 0 ? hood.opaqueColumn(s - 1, x, z) >> (S - 1) : hood.isOpaque(x, -1, z);
+
+                uint32_t visible[6];
+                visible[FRONT]  = column & ~hood.opaqueColumn(s, x, z + 1);
+                visible[BACK]   = column & ~hood.opaqueColumn(s, x, z - 1);
+                visible[LEFT]   = column & ~hood.opaqueColumn(s, x - 1, z);
+                visible[RIGHT]  = column & ~hood.opaqueColumn(s, x + 1, z);
+                visible[TOP]    = column & ~((column >> 1) | (above << (S - 1)));
+                visible[BOTTOM] = column & ~((column << 1) | below);
+
+                for (int f = 0; f < 6; ++f) {
+                    for (uint32_t bits = visible[f]; bits; bits &= bits - 1) {
+                        glm::ivec3 localPos(x, s * S + lowestBit(bits), z);
+                        m.positions.push_back(chunkPos * CHUNK_SIZE + localPos);
+                        m.faces.push_back(static_cast<Face>(f));
+                        m.types.push_back(hood.get(localPos));
+                    }
                 }
             }
         }
+
+        if (hood.hasNonOpaqueBlocks(s)) addNonOpaqueFaces(m, hood, s);
+    }
+
+    addFaces(m);
+
+    // Hand the mesh over to uploadMeshToGPU, dropping one that was never uploaded
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        std::swap(mesh, buffers);
     }
+    if (buffers) releaseMesh(std::move(buffers));
 
-    addFaces(meshPositions, meshFaces, meshTypes);
+    meshedVersion = hood.getVersion();
+    meshedRemeshRequests = hood.getRemeshStamp();
     meshGenerated = true;
     uploadingToGPU = true;
-    busy = false;
 }
 
-void Chunk::addFaces(const std::vector<glm::ivec3>& meshPositions, 
-                     const std::vector<Face>& meshFaces, 
-                     const std::vector<BlockType>& meshTypes) {
+// Blocks left out of the opaque masks (glass, water...), tested one by one
+void Chunk::addNonOpaqueFaces(MeshBuffers& m, const ChunkNeighborhood& hood, int section) {
+    static const glm::ivec3 faceDirs[6] = {
+        { 0, 0,  1}, // FRONT  (+Z)
+        { 0, 0, -1}, // BACK   (-Z)
+        {-1, 0,  0}, // LEFT   (-X)
+        { 1, 0,  0}, // RIGHT  (+X)
+        { 0, 1,  0}, // TOP    (+Y)
+        { 0,-1,  0}, // BOTTOM (-Y)
+    };
+
+    const int baseY = section * ChunkSection::SIZE;
+    for (int x = 0; x < ChunkSection::SIZE; ++x) {
+        for (int z = 0; z < ChunkSection::SIZE; ++z) {
+            for (int y = baseY; y < baseY + ChunkSection::SIZE; ++y) {
+                BlockType type = hood.get(x, y, z);
+                const BlockInfo& info = blockInfo(type);
+                if (type == AIR || info.opaque) continue;
+
+                glm::ivec3 localPos(x, y, z);
+                for (int f = 0; f < 6; ++f) {
+                    // Padded: the neighbour may be in the next chunk
+                    BlockType neighbour = hood.get(localPos + faceDirs[f]);
+                    bool hidden = info.cull != CULL_NEVER
+                        && (blockInfo(neighbour).opaque || (info.cull == CULL_SAME && neighbour == type));
+                    if (hidden) continue;
+                    m.positions.push_back(chunkPos * CHUNK_SIZE + localPos);
+                    m.faces.push_back(static_cast<Face>(f));
+                    m.types.push_back(type);
+                }
+            }
+        }
+    }
+}
+
+void Chunk::addFaces(MeshBuffers& m) {
     static const glm::vec3 nrm[6] = {
         { 0, 0,  1}, // FRONT  (+Z)
         { 0, 0, -1}, // BACK   (-Z)
@@ -291,20 +640,14 @@ void Chunk::addFaces(const std::vector<glm::ivec3>& meshPositions,
         {0,0}, {1,0}, {1,1}, {0,1}
     };
 
-    for (size_t idx = 0; idx < meshPositions.size(); ++idx) {
-        const glm::vec3 base(meshPositions[idx]); // coin min du bloc (x,y,z)
-        Face f = meshFaces[idx];
-        BlockType type = meshTypes[idx];
-        int tileID;
-        switch (f) {
-            case FRONT:  tileID = blockTextures[type].front;  break;
-            case BACK:   tileID = blockTextures[type].back;   break;
-            case LEFT:   tileID = blockTextures[type].left;   break;
-            case RIGHT:  tileID = blockTextures[type].right;  break;
-            case TOP:    tileID = blockTextures[type].top;    break;
-            case BOTTOM: tileID = blockTextures[type].bottom; break;
-        }
-        uint32_t baseIndex = static_cast<uint32_t>(vertices.size());
+    m.vertices.reserve(m.faces.size() * 4);
+    m.indices.reserve(m.faces.size() * 6);
+    for (size_t idx = 0; idx < m.positions.size(); ++idx) {
+        const glm::vec3 base(m.positions[idx]); // coin min du bloc (x,y,z)
+        Face f = m.faces[idx];
+        BlockType type = m.types[idx];
+        int tileID = blockInfo(type).tiles[f];
+        uint32_t baseIndex = static_cast<uint32_t>(m.vertices.size());
         // 4 sommets
         for (int i = 0; i < 4; ++i) {
             Vertex vert;
@@ -312,23 +655,32 @@ void Chunk::addFaces(const std::vector<glm::ivec3>& meshPositions,
             vert.uv        = uv[i];
             vert.normal    = nrm[f];
             vert.faceID = tileID; // même tuile sur la face
-            vertices.push_back(vert);
+            m.vertices.push_back(vert);
         }
 
         // 2 triangles: (0,1,2) et (0,2,3)
-        indices.push_back(baseIndex + 0);
-        indices.push_back(baseIndex + 1);
-        indices.push_back(baseIndex + 2);
+        m.indices.push_back(baseIndex + 0);
+        m.indices.push_back(baseIndex + 1);
+        m.indices.push_back(baseIndex + 2);
 
-        indices.push_back(baseIndex + 0);
-        indices.push_back(baseIndex + 2);
-        indices.push_back(baseIndex + 3);
+        m.indices.push_back(baseIndex + 0);
+        m.indices.push_back(baseIndex + 2);
+        m.indices.push_back(baseIndex + 3);
     }
 }
 
 
 void Chunk::uploadMeshToGPU()
 {
+    std::unique_ptr<MeshBuffers> buffers;
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        buffers = std::move(mesh);
+    }
+    if (!buffers) return; // already uploaded
+    const std::vector<Vertex>& vertices = buffers->vertices;
+    const std::vector<uint32_t>& indices = buffers->indices;
+
     if (gl.vao == 0) {
         glGenVertexArrays(1, &gl.vao);
         glGenBuffers(1, &gl.vbo);
@@ -376,45 +728,151 @@ void Chunk::uploadMeshToGPU()
     glBindVertexArray(0);
 
     gl.indexCount = indices.size();
+    gl.bytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t);
+    releaseMesh(std::move(buffers));
+}
+
+
+std::unique_ptr<MeshBuffers> Chunk::acquireMesh() {
+    if (pool) return pool->acquireMesh();
+    return std::make_unique<MeshBuffers>();
+}
+
+void Chunk::releaseMesh(std::unique_ptr<MeshBuffers> buffers) {
+    if (pool) pool->releaseMesh(std::move(buffers));
+}
+
+
+// Back to a blank chunk for the pool. The GL objects are kept but their
+// storage is dropped, so that evicted chunks really give the memory back.
+void Chunk::reset() {
+    std::unique_ptr<MeshBuffers> buffers;
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        sections = makeSections();
+        heightMap.fill(0);
+        minOccupiedY = CHUNK_SIZE.y;
+        maxOccupiedY = -1;
+        buffers = std::move(mesh);
+        metadata.reset();
+        version++;
+        meshedVersion = 0;
+        meshedRemeshRequests = remeshRequests.load();
+        savedVersion = version.load();
+    }
+    if (buffers) releaseMesh(std::move(buffers));
+
+    meshGenerated = false;
+    uploadingToGPU = false;
+    busy = false;
+    lastVisibleFrame = 0;
+    structuresGenerated = false;
+    if (gl.bytes != 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, gl.vbo);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+    }
+    gl.indexCount = 0;
+    gl.bytes = 0;
+}
+
+
+// Chunk file layout:
+//   magic, block order, chunkPos, section count, then for every section:
+//   bits per entry (uint8), palette size (uint16), palette, packed words,
+//   then the block metadata (see BlockMetadata::write).
+// All-air and uniform sections therefore only cost a few bytes.
+// "CHK3" files stop after the sections, "CHK2" files also have no block
+// order byte and always use ORDER_XYZ.
+static const uint32_t CHUNK_FILE_MAGIC = 0x344B4843;    // "CHK4"
+static const uint32_t CHUNK_FILE_MAGIC_V3 = 0x334B4843; // "CHK3"
+static const uint32_t CHUNK_FILE_MAGIC_V2 = 0x324B4843; // "CHK2"
+
+// Edited sections are compacted and shared again when possible,
+// the ones still used elsewhere are written as they are
+ChunkSnapshot Chunk::compactedSnapshot() {
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        for (auto& section : sections) {
+            if (section.use_count() == 1) {
+                section->compact();
+                section = SectionCache::instance().intern(section);
+            }
+        }
+    }
+    return snapshot();
 }
 
 
 void Chunk::saveToFile(const std::string& filename) {
+    ChunkSnapshot snap = compactedSnapshot();
+    if (snap.saveToFile(filename)) savedVersion = snap.version;
+}
+
+
+bool Chunk::write(std::ostream& out) {
+    return compactedSnapshot().write(out);
+}
+
+
+bool Chunk::saveEncoded(const std::string& filename, const std::string& data) {
+    std::string filenameBlocks = filename + ".blk";
+    std::ofstream file(filenameBlocks, std::ios::binary);
+    file.write(data.data(), data.size());
+    if (!file) {
+        std::cerr << "Failed to write file: " << filenameBlocks << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool ChunkSnapshot::saveToFile(const std::string& filename) const {
     std::string filenameBlocks = filename + ".blk";
     std::ofstream file(filenameBlocks, std::ios::binary);
     if (!file) {
         std::cerr << "Failed to open file for writing: " << filename << std::endl;
-        return;
+        return false;
+    }
+    if (!write(file)) {
+        std::cerr << "Failed to write file: " << filenameBlocks << std::endl;
+        return false;
     }
+    return true;
+}
+
 
+bool ChunkSnapshot::write(std::ostream& file) const {
+    file.write(reinterpret_cast<const char*>(&CHUNK_FILE_MAGIC), sizeof(CHUNK_FILE_MAGIC));
+    uint8_t order = SectionOrder::ID;
+    file.write(reinterpret_cast<const char*>(&order), sizeof(order));
     file.write(reinterpret_cast<const char*>(&chunkPos), sizeof(chunkPos));
 
-    uint32_t nonAirCount = 0;
-    for (const auto& block : blocks) {
-        if (block.type != AIR) nonAirCount++;
-    }
-    file.write(reinterpret_cast<const char*>(&nonAirCount), sizeof(nonAirCount));
-
-    std::unordered_map<uint8_t, std::vector<uint16_t>> typeToPositions;
-    for (auto& block : blocks) {
-        if (block.type != AIR) {
-            uint8_t type = static_cast<uint8_t>(block.type);
-            glm::ivec3 pos = glm::ivec3(block.position);
-            uint16_t index = pos.x 
-                           + pos.y * CHUNK_SIZE.x
-                           + pos.z * CHUNK_SIZE.x * CHUNK_SIZE.y;
-            typeToPositions[type].push_back(index);
-        }
-    }
+    uint8_t sectionCount = static_cast<uint8_t>(sections.size());
+    file.write(reinterpret_cast<const char*>(&sectionCount), sizeof(sectionCount));
+
+    for (const auto& section : sections) {
+        const PaletteStorage& storage = section->storage();
+
+        uint8_t bits = static_cast<uint8_t>(storage.getBitsPerEntry());
+        file.write(reinterpret_cast<const char*>(&bits), sizeof(bits));
 
-    for (auto& [type, positions] : typeToPositions) {
-        file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+        const std::vector<BlockType>& palette = storage.getPalette();
+        uint16_t paletteSize = static_cast<uint16_t>(palette.size());
+        file.write(reinterpret_cast<const char*>(&paletteSize), sizeof(paletteSize));
+        file.write(reinterpret_cast<const char*>(palette.data()), paletteSize * sizeof(BlockType));
 
-        uint16_t count = positions.size();
-        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        const std::vector<uint64_t>& words = storage.getWords();
+        file.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+    }
 
-        file.write(reinterpret_cast<const char*>(positions.data()), count * sizeof(uint16_t));
+    if (metadata) {
+        metadata->write(file);
+    } else {
+        BlockMetadata().write(file);
     }
+    return static_cast<bool>(file);
 }
 
 
@@ -433,53 +891,85 @@ void Chunk::loadFromFile(const std::string& filename) {
         std::cerr << "Failed to open file for reading: " << filenameBlocks << std::endl;
         return;
     }
+    read(file);
+}
 
-    file.read(reinterpret_cast<char*>(&chunkPos), sizeof(chunkPos));
 
-    uint32_t nonAirCount;
-    file.read(reinterpret_cast<char*>(&nonAirCount), sizeof(nonAirCount));
-    if (nonAirCount > CHUNK_SIZE.x * CHUNK_SIZE.y * CHUNK_SIZE.z) {
-        std::cerr << "Corrupted file: invalid nonAirCount=" << nonAirCount << "\n";
-        return;
+bool Chunk::read(std::istream& file) {
+    uint32_t magic = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    // Files from before the sections lived in a directory that is no longer read
+    if (!file || (magic != CHUNK_FILE_MAGIC && magic != CHUNK_FILE_MAGIC_V3 && magic != CHUNK_FILE_MAGIC_V2)) {
+        std::cerr << "Corrupted file: unknown magic=" << std::hex << magic << std::dec << "\n";
+        return false;
     }
 
-    blocks.assign(CHUNK_SIZE.x * CHUNK_SIZE.y * CHUNK_SIZE.z, {{0,0,0}, AIR});
-
-    uint32_t placed = 0;
-    while (placed < nonAirCount && file) {
-        uint8_t type;
-        file.read(reinterpret_cast<char*>(&type), sizeof(type));
-        if (!file) break;
+    uint8_t order = ORDER_XYZ;
+    if (magic != CHUNK_FILE_MAGIC_V2) {
+        file.read(reinterpret_cast<char*>(&order), sizeof(order));
+    }
+    if (order > ORDER_MORTON) {
+        std::cerr << "Corrupted file: unknown block order=" << int(order) << "\n";
+        return false;
+    }
+    glm::ivec3 pos;
+    file.read(reinterpret_cast<char*>(&pos), sizeof(pos));
+
+    uint8_t sectionCount = 0;
+    file.read(reinterpret_cast<char*>(&sectionCount), sizeof(sectionCount));
+    if (!file || sectionCount != SECTION_COUNT) {
+        std::cerr << "Corrupted file: invalid section count=" << int(sectionCount) << "\n";
+        return false;
+    }
 
-        uint16_t count;
-        file.read(reinterpret_cast<char*>(&count), sizeof(count));
-        if (!file || count == 0 || count > blocks.size()) {
-            std::cerr << "Corrupted file: invalid count=" << count << "\n";
-            return;
+    // Built aside, the chunk only changes once the whole file has been read
+    SectionArray loaded;
+    for (auto& sectionPtr : loaded) {
+        sectionPtr = std::make_shared<ChunkSection>();
+        ChunkSection& section = *sectionPtr;
+        uint8_t bits = 0;
+        uint16_t paletteSize = 0;
+        file.read(reinterpret_cast<char*>(&bits), sizeof(bits));
+        file.read(reinterpret_cast<char*>(&paletteSize), sizeof(paletteSize));
+        if (!file || paletteSize == 0 || paletteSize > 256) {
+            std::cerr << "Corrupted file: invalid palette size=" << paletteSize << "\n";
+            return false;
         }
 
-        std::vector<uint16_t> positions(count);
-        file.read(reinterpret_cast<char*>(positions.data()), count * sizeof(uint16_t));
+        std::vector<BlockType> palette(paletteSize);
+        file.read(reinterpret_cast<char*>(palette.data()), paletteSize * sizeof(BlockType));
+
+        std::vector<uint64_t> words(PaletteStorage::wordCount(ChunkSection::VOLUME, bits));
+        file.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint64_t));
         if (!file) {
-            std::cerr << "Corrupted file: premature EOF while reading positions\n";
-            return;
+            std::cerr << "Corrupted file: premature EOF while reading sections\n";
+            return false;
         }
 
-        for (uint16_t index : positions) {
-            if (index >= blocks.size()) {
-                std::cerr << "Corrupted file: index out of bounds (" << index << ")\n";
-                return;
+        PaletteStorage stored(ChunkSection::VOLUME);
+        if (!stored.assign(std::move(palette), bits, std::move(words))) {
+            std::cerr << "Corrupted file: inconsistent section data\n";
+            return false;
+        }
+
+        if (order == SectionOrder::ID) {
+            section.assign(std::move(stored));
+        } else {
+            // Saved with another block order: move every block to its new index
+            section = ChunkSection(stored.getPalette()[0]);
+            for (int i = 0; i < ChunkSection::VOLUME; i++) {
+                glm::ivec3 p = ChunkSection::localPosOf(i);
+                section.set(i, stored.get(sectionIndex(static_cast<BlockOrderId>(order), p.x, p.y, p.z)));
             }
-            Block& b = blocks[index];
-            b.type = static_cast<BlockType>(type);
-            b.position = chunkPos * CHUNK_SIZE + glm::ivec3(
-                index % CHUNK_SIZE.x,
-                (index / CHUNK_SIZE.x) % CHUNK_SIZE.y,
-                index / (CHUNK_SIZE.x * CHUNK_SIZE.y)
-            );
+            section.compact();
         }
-        placed += count;
     }
-}
-
 
+    std::shared_ptr<BlockMetadata> loadedMetadata;
+    if (magic == CHUNK_FILE_MAGIC) {
+        loadedMetadata = std::make_shared<BlockMetadata>();
+        if (!loadedMetadata->read(file, ChunkLayout::VOLUME)) return false;
+    }
+    installSections(pos, std::move(loaded), std::move(loadedMetadata));
+    return true;
+}
@@ -0,0 +1,58 @@
+#include "../include/ChunkColdCache.h"
+
+void ChunkColdCache::put(const glm::ivec3& pos, std::string blob, bool dirty) {
+    stats.puts++;
+    auto found = index.find(pos);
+    if (found != index.end()) {
+        // Still dirty if the older copy never reached the disk
+        Entry old;
+        removeEntry(found->second, old);
+        dirty = dirty || old.dirty;
+    }
+    totalBytes += blob.size();
+    entries.push_front({pos, std::move(blob), dirty});
+    index[pos] = entries.begin();
+}
+
+
+bool ChunkColdCache::take(const glm::ivec3& pos, Entry& out) {
+    auto found = index.find(pos);
+    if (found == index.end()) {
+        stats.misses++;
+        return false;
+    }
+    stats.hits++;
+    removeEntry(found->second, out);
+    return true;
+}
+
+
+bool ChunkColdCache::popOverflow(Entry& out) {
+    if (totalBytes <= capacity) return false;
+    if (!popOldest(out)) return false;
+    stats.evictions++;
+    return true;
+}
+
+
+bool ChunkColdCache::popOldest(Entry& out) {
+    if (entries.empty()) return false;
+    removeEntry(std::prev(entries.end()), out);
+    return true;
+}
+
+
+void ChunkColdCache::removeEntry(std::list<Entry>::iterator it, Entry& out) {
+    totalBytes -= it->blob.size();
+    index.erase(it->pos);
+    out = std::move(*it);
+    entries.erase(it);
+}
+
+
+ChunkColdCache::Stats ChunkColdCache::getStats() const {
+    Stats result = stats;
+    result.entries = entries.size();
+    result.bytes = totalBytes;
+    return result;
+}
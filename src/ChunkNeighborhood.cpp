@@ -0,0 +1,85 @@
+#include "../include/ChunkNeighborhood.h"
+
+void ChunkNeighborhood::build(const Chunk& chunk, const Neighbors& neighbors) {
+    // Read before the snapshot: a request made after it triggers another mesh
+    remeshStamp = chunk.getRemeshRequests();
+    ChunkSnapshot center = chunk.snapshot();
+    chunkPos = center.chunkPos;
+    version = center.version;
+    minY = center.minY;
+    maxY = center.maxY;
+    types.resize(VOLUME);
+    columns.resize(PAD_X * PAD_Z * Chunk::SECTION_COUNT);
+
+    copyCenter(center);
+    for (int i = 0; i < COUNT; i++) {
+        if (i == CENTER) continue;
+        present[i] = neighbors[i] != nullptr;
+        if (present[i]) {
+            ChunkSnapshot snap = neighbors[i]->snapshot();
+            copyBorder(i, &snap);
+        } else {
+            copyBorder(i, nullptr);
+        }
+    }
+    present[CENTER] = true;
+    buildBorderColumns();
+}
+
+
+void ChunkNeighborhood::copyCenter(const ChunkSnapshot& center) {
+    std::array<BlockType, ChunkSection::VOLUME> decoded;
+    for (int s = 0; s < Chunk::SECTION_COUNT; s++) {
+        const ChunkSection& section = *center.sections[s];
+        sectionEmpty[s] = section.isEmpty();
+        sectionNonOpaque[s] = section.hasNonOpaqueBlocks();
+        section.storage().unpack(decoded.data());
+        const int baseY = s * ChunkSection::SIZE;
+        for (int x = 0; x < ChunkSection::SIZE; x++) {
+            for (int z = 0; z < ChunkSection::SIZE; z++) {
+                BlockType* column = &types[paddedIndex(x, baseY, z)];
+                for (int y = 0; y < ChunkSection::SIZE; y++) column[y] = decoded[ChunkSection::indexOf(x, y, z)];
+                columns[(x + 1) + (z + 1) * PAD_X + s * PAD_X * PAD_Z] = section.opaqueColumn(x, z);
+            }
+        }
+    }
+}
+
+
+void ChunkNeighborhood::copyBorder(int i, const ChunkSnapshot* neighbor) {
+    const glm::ivec3 d = offsetOf(i);
+    const glm::ivec3 size = Chunk::CHUNK_SIZE;
+    // Padded range covered by this neighbour on each axis, and where it reads in it
+    glm::ivec3 begin, end, shift;
+    for (int a = 0; a < 3; a++) {
+        if (d[a] < 0)      { begin[a] = -1;      end[a] = 0;           shift[a] = size[a]; }
+        else if (d[a] > 0) { begin[a] = size[a]; end[a] = size[a] + 1; shift[a] = -size[a]; }
+        else               { begin[a] = 0;       end[a] = size[a];     shift[a] = 0; }
+    }
+
+    for (int x = begin.x; x < end.x; x++) {
+        for (int z = begin.z; z < end.z; z++) {
+            for (int y = begin.y; y < end.y; y++) {
+                types[paddedIndex(x, y, z)] = neighbor ? neighbor->getBlockAt(glm::ivec3(x, y, z) + shift) : AIR;
+            }
+        }
+    }
+}
+
+
+void ChunkNeighborhood::buildBorderColumns() {
+    for (int s = 0; s < Chunk::SECTION_COUNT; s++) {
+        const int baseY = s * ChunkSection::SIZE;
+        for (int x = -1; x <= ChunkSection::SIZE; x++) {
+            for (int z = -1; z <= ChunkSection::SIZE; z++) {
+                bool inside = x >= 0 && x < ChunkSection::SIZE && z >= 0 && z < ChunkSection::SIZE;
+                if (inside) continue; // copied from the section
+                ChunkSection::ColumnMask mask = 0;
+                for (int y = 0; y < ChunkSection::SIZE; y++) {
+                    if (isOpaque(x, baseY + y, z)) mask |= static_cast<ChunkSection::ColumnMask>(1u << y);
+                }
+                columns[(x + 1) + (z + 1) * PAD_X + s * PAD_X * PAD_Z] = mask;
+            }
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#include "../include/ChunkPool.h"
+#include <algorithm>
+#include <iostream>
+
+ChunkHandle ChunkPool::acquire(const glm::ivec3& pos) {
+    recyclePending();
+
+    uint32_t index;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.chunkRequests++;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+            stats.chunkHits++;
+        } else {
+            index = slotsUsed.load(std::memory_order_relaxed);
+            if (index >= PAGE_SIZE * MAX_PAGES) {
+                std::cerr << "Chunk pool full (" << index << " chunks)\n";
+                return {};
+            }
+            if (!pages[index / PAGE_SIZE]) pages[index / PAGE_SIZE].reset(new Slot[PAGE_SIZE]);
+            Slot& slot = slotAt(index);
+            slot.chunk = std::make_unique<Chunk>(pos);
+            slot.chunk->pool = this;
+            stats.chunksAllocated++;
+            updateFootprint();
+            // Publish the slot once it is fully built
+            slotsUsed.store(index + 1, std::memory_order_release);
+        }
+    }
+
+    Slot& slot = slotAt(index);
+    slot.chunk->chunkPos = pos;
+    uint32_t generation = slot.generation.load(std::memory_order_relaxed) + 1; // odd: in use
+    slot.generation.store(generation, std::memory_order_release);
+    return {index, generation};
+}
+
+
+void ChunkPool::release(ChunkHandle handle) {
+    if (!isValid(handle)) return;
+    Slot& slot = slotAt(handle.index);
+    // Invalidate first: a worker pinning after this sees the new generation,
+    // one that pinned before has set `busy` and we leave the chunk alone
+    slot.generation.fetch_add(1);
+    if (slot.chunk->busy) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingSlots.push_back(handle.index);
+        return;
+    }
+
+    slot.chunk->reset();
+    std::lock_guard<std::mutex> lock(mutex);
+    freeSlots.push_back(handle.index);
+}
+
+
+Chunk* ChunkPool::pin(ChunkHandle handle) {
+    if (!isValid(handle)) return nullptr;
+    Chunk* chunk = slotAt(handle.index).chunk.get();
+    chunk->busy = true;
+    // Released in between: release() may not have seen `busy`
+    if (slotAt(handle.index).generation.load() != handle.generation) {
+        chunk->busy = false;
+        return nullptr;
+    }
+    return chunk;
+}
+
+
+void ChunkPool::recyclePending() {
+    std::vector<uint32_t> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < pendingSlots.size();) {
+            if (slotAt(pendingSlots[i]).chunk->busy) {
+                i++;
+                continue;
+            }
+            ready.push_back(pendingSlots[i]);
+            pendingSlots[i] = pendingSlots.back();
+            pendingSlots.pop_back();
+        }
+    }
+    if (ready.empty()) return;
+    for (uint32_t index : ready) slotAt(index).chunk->reset();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    freeSlots.insert(freeSlots.end(), ready.begin(), ready.end());
+}
+
+
+std::unique_ptr<MeshBuffers> ChunkPool::acquireMesh() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.meshRequests++;
+    if (freeMeshes.empty()) {
+        stats.meshBuffersAllocated++;
+        return std::make_unique<MeshBuffers>();
+    }
+    stats.meshHits++;
+    std::unique_ptr<MeshBuffers> buffers = std::move(freeMeshes.back());
+    freeMeshes.pop_back();
+    return buffers;
+}
+
+
+void ChunkPool::releaseMesh(std::unique_ptr<MeshBuffers> buffers) {
+    if (!buffers) return;
+    size_t bytes = buffers->memoryUsage();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // The buffers only grow while they are out of the pool
+    meshBytes += bytes - buffers->accountedBytes;
+    buffers->accountedBytes = bytes;
+    freeMeshes.push_back(std::move(buffers));
+    updateFootprint();
+}
+
+
+size_t ChunkPool::trimMeshes() {
+    std::vector<std::unique_ptr<MeshBuffers>> freed;
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& buffers : freeMeshes) bytes += buffers->accountedBytes;
+        freed.swap(freeMeshes);
+        meshBytes -= bytes;
+        updateFootprint();
+    }
+    return bytes; // freed outside of the lock
+}
+
+
+void ChunkPool::updateFootprint() {
+    stats.meshBufferBytes = meshBytes;
+    stats.footprintBytes = stats.chunksAllocated * sizeof(Chunk) + meshBytes;
+    stats.peakFootprintBytes = std::max(stats.peakFootprintBytes, stats.footprintBytes);
+}
+
+
+ChunkPool::Stats ChunkPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.chunksFree = freeSlots.size();
+    result.pendingReleases = pendingSlots.size();
+    return result;
+}
+
+
+void ChunkPool::printStats() const {
+    Stats s = getStats();
+    auto rate = [](size_t hits, size_t requests) {
+        return requests == 0 ? 0.0f : 100.0f * hits / requests;
+    };
+    std::cout << "Chunk pool: " << s.chunksAllocated << " chunks allocated, " << s.chunksFree << " free, "
+              << s.pendingReleases << " waiting for a worker, "
+              << rate(s.chunkHits, s.chunkRequests) << "% hits (" << s.chunkRequests << " requests)\n"
+              << "  mesh buffers: " << s.meshBuffersAllocated << " allocated, "
+              << rate(s.meshHits, s.meshRequests) << "% hits (" << s.meshRequests << " requests)\n"
+              << "  footprint: " << s.footprintBytes / 1024 << " KB (peak " << s.peakFootprintBytes / 1024 << " KB)"
+              << std::endl;
+}
@@ -0,0 +1,26 @@
+#include "../include/ChunkRegistry.h"
+
+ChunkRegistry::ChunkRegistry() {
+    published = std::make_shared<Map>();
+    std::atomic_store_explicit(&current, Snapshot(published), std::memory_order_release);
+}
+
+
+void ChunkRegistry::publish(const Map& map) {
+    // Readers only get copies through `current`, so a spare nobody else
+    // references can't be picked up by anyone in the meantime
+    std::shared_ptr<Map> next;
+    if (spare && spare.use_count() == 1) {
+        // Pairs with the release of the last reader dropping it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        next = std::move(spare);
+        *next = map; // keeps the capacity of the slot array
+    } else {
+        next = std::make_shared<Map>(map);
+        spare.reset(); // still read somewhere, the last reader frees it
+    }
+
+    std::atomic_store_explicit(&current, Snapshot(next), std::memory_order_release);
+    spare = std::move(published);
+    published = std::move(next);
+}
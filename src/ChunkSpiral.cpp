@@ -0,0 +1,31 @@
+#include "../include/ChunkSpiral.h"
+#include <algorithm>
+#include <cstdint>
+
+ChunkSpiral::ChunkSpiral(int viewDistance, int verticalDistance)
+    : viewDistance(viewDistance), verticalDistance(verticalDistance) {
+    for (int x = -viewDistance; x <= viewDistance; x++) {
+        for (int z = -viewDistance; z <= viewDistance; z++) {
+            // Disc rather than square, same test as glm::length(vec2(x, z)) <= viewDistance
+            if (x * x + z * z > viewDistance * viewDistance) continue;
+            for (int y = -verticalDistance; y <= verticalDistance; y++) {
+                offsets.push_back(glm::ivec3(x, y, z));
+            }
+        }
+    }
+
+    auto distance2 = [](const glm::ivec3& offset) {
+        int64_t x = int64_t(offset.x) * ChunkLayout::SIZE_X;
+        int64_t y = int64_t(offset.y) * ChunkLayout::SIZE_Y;
+        int64_t z = int64_t(offset.z) * ChunkLayout::SIZE_Z;
+        return x * x + y * y + z * z;
+    };
+    // Ties broken on the coordinates so that the order doesn't depend on the sort
+    std::sort(offsets.begin(), offsets.end(), [&](const glm::ivec3& a, const glm::ivec3& b) {
+        int64_t da = distance2(a), db = distance2(b);
+        if (da != db) return da < db;
+        if (a.y != b.y) return a.y < b.y;
+        if (a.x != b.x) return a.x < b.x;
+        return a.z < b.z;
+    });
+}
@@ -0,0 +1,341 @@
+#include "../include/PaletteStorage.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PALETTE_SSE2 1
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int shiftFor(int bits) {
+    switch (bits) {
+        case 1: return 0;
+        case 4: return 2;
+        case 8: return 3;
+        default: return 0;
+    }
+}
+
+// Smallest supported index width able to address `paletteSize` entries
+static int bitsFor(size_t paletteSize) {
+    if (paletteSize <= 1) return 0;
+    if (paletteSize <= 2) return 1;
+    if (paletteSize <= 16) return 4;
+    return 8;
+}
+
+size_t PaletteStorage::wordCount(size_t entries, int bits) {
+    if (bits == 0) return 0;
+    return (entries * bits + 63) / 64;
+}
+
+PaletteStorage::PaletteStorage(size_t size, BlockType fill)
+    : entryCount(size), bits(0), bitsShift(0), palette{fill} {}
+
+void PaletteStorage::set(size_t index, BlockType type) {
+    uint32_t paletteIndex = paletteIndexOf(type);
+    if (bits == 0) return; // uniform and `type` is the only entry
+    writeIndex(data, bitsShift, index, paletteIndex);
+}
+
+void PaletteStorage::unpack(BlockType* out) const {
+    if (bits == 0) {
+        std::fill(out, out + entryCount, palette[0]);
+        return;
+    }
+
+    int perWord = 64 >> bitsShift;
+    uint64_t mask = (1ull << bits) - 1;
+
+    size_t index = 0;
+    for (uint64_t word : data) {
+        for (int i = 0; i < perWord && index < entryCount; i++, index++) {
+            out[index] = palette[word & mask];
+            word >>= bits;
+        }
+    }
+}
+
+void PaletteStorage::compact() {
+    if (bits == 0) return;
+
+    std::vector<bool> used(palette.size(), false);
+    for (size_t i = 0; i < entryCount; i++) {
+        used[readIndex(data, bitsShift, i)] = true;
+    }
+
+    std::vector<BlockType> newPalette;
+    std::vector<uint32_t> remap(palette.size(), 0);
+    for (size_t i = 0; i < palette.size(); i++) {
+        if (!used[i]) continue;
+        remap[i] = static_cast<uint32_t>(newPalette.size());
+        newPalette.push_back(palette[i]);
+    }
+    if (newPalette.size() == palette.size()) return;
+
+    int newBits = bitsFor(newPalette.size());
+    if (newBits == 0) {
+        data.clear();
+        data.shrink_to_fit();
+        bits = 0;
+    } else {
+        repack(newBits, remap);
+    }
+    palette = std::move(newPalette);
+}
+
+bool PaletteStorage::assign(std::vector<BlockType> newPalette, int newBits, std::vector<uint64_t> words) {
+    if (newPalette.empty() || newPalette.size() > 256) return false;
+    if (newBits != 0 && newBits != 1 && newBits != 4 && newBits != 8) return false;
+    if (newPalette.size() > (size_t(1) << newBits)) return false;
+    if (words.size() != wordCount(entryCount, newBits)) return false;
+    // Types index the per-type tables of the sections, and a type appears once
+    std::array<bool, BLOCK_TYPE_COUNT> seen{};
+    for (BlockType type : newPalette) {
+        if (type >= BLOCK_TYPE_COUNT || seen[type]) return false;
+        seen[type] = true;
+    }
+
+    int newShift = shiftFor(newBits);
+    if (newBits > 0) {
+        for (size_t i = 0; i < entryCount; i++) {
+            if (readIndex(words, newShift, i) >= newPalette.size()) return false;
+        }
+    }
+
+    palette = std::move(newPalette);
+    data = std::move(words);
+    bits = newBits;
+    bitsShift = newShift;
+    return true;
+}
+
+void PaletteStorage::writeIndex(std::vector<uint64_t>& words, int bitsShift, size_t index, uint32_t value) {
+    int perWordShift = 6 - bitsShift;
+    int offset = static_cast<int>(index & ((size_t(1) << perWordShift) - 1)) << bitsShift;
+    uint64_t mask = ((1ull << (1 << bitsShift)) - 1) << offset;
+    uint64_t& word = words[index >> perWordShift];
+    word = (word & ~mask) | (static_cast<uint64_t>(value) << offset);
+}
+
+uint32_t PaletteStorage::paletteIndexOf(BlockType type) {
+    for (size_t i = 0; i < palette.size(); i++) {
+        if (palette[i] == type) return static_cast<uint32_t>(i);
+    }
+
+    // New type: widen the indices when the palette no longer fits (0 -> 1 -> 4 -> 8 bits)
+    palette.push_back(type);
+    int neededBits = bitsFor(palette.size());
+    if (neededBits != bits) {
+        repack(neededBits);
+    }
+    assert(palette.size() <= 256);
+    return static_cast<uint32_t>(palette.size() - 1);
+}
+
+// Re-encodes every index with `newBits` bits, optionally translating them through `remap`
+void PaletteStorage::repack(int newBits, const std::vector<uint32_t>& remap) {
+    int newShift = shiftFor(newBits);
+    std::vector<uint64_t> packed(wordCount(entryCount, newBits), 0);
+    for (size_t i = 0; i < entryCount; i++) {
+        uint32_t value = bits == 0 ? 0 : readIndex(data, bitsShift, i);
+        if (!remap.empty()) value = remap[value];
+        writeIndex(packed, newShift, i, value);
+    }
+    data = std::move(packed);
+    bits = newBits;
+    bitsShift = newShift;
+}
+
+size_t PaletteStorage::memoryUsage() const {
+    return sizeof(*this)
+         + palette.capacity() * sizeof(BlockType)
+         + data.capacity() * sizeof(uint64_t);
+}
+
+
+// ---- Bulk kernels ----
+// Entries are lanes of 1, 4 or 8 bits inside the 64-bit words (SWAR). A lane
+// equal to a value is found by xoring with that value repeated in every lane,
+// then testing the lanes for zero without carries crossing them.
+
+static int popCount64(uint64_t v) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(v));
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+// `value` in every lane of a word
+static uint64_t broadcast(uint32_t value, int bits) {
+    uint64_t lanes = 0;
+    for (int offset = 0; offset < 64; offset += bits) lanes |= static_cast<uint64_t>(value) << offset;
+    return lanes;
+}
+
+// Top bit of every lane
+static uint64_t laneHighBits(int bits) { return broadcast(1u << (bits - 1), bits); }
+
+// Top bit set in the lanes of `x` that are zero
+static uint64_t zeroLanes(uint64_t x, uint64_t high) {
+    uint64_t low = ~high;
+    return ~(((x & low) + low) | x) & high;
+}
+
+// Whole lanes from their top bit
+static uint64_t widenLanes(uint64_t highBits, int bits) {
+    return highBits | (highBits - (highBits >> (bits - 1)));
+}
+
+// Bits of the lanes [first, last) of a word
+static uint64_t laneRange(int first, int last, int bits) {
+    uint64_t upper = last * bits >= 64 ? ~0ull : (1ull << (last * bits)) - 1;
+    uint64_t lower = (1ull << (first * bits)) - 1;
+    return upper & ~lower;
+}
+
+#ifdef PALETTE_SSE2
+static __m128i zeroLanes(__m128i x, __m128i high) {
+    __m128i low = _mm_andnot_si128(high, _mm_set1_epi32(-1));
+    __m128i t = _mm_or_si128(_mm_add_epi64(_mm_and_si128(x, low), low), x);
+    return _mm_andnot_si128(t, high);
+}
+#endif
+
+int PaletteStorage::findPaletteIndex(BlockType type) const {
+    for (size_t i = 0; i < palette.size(); i++) {
+        if (palette[i] == type) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void PaletteStorage::fill(size_t begin, size_t end, BlockType type) {
+    end = std::min(end, entryCount);
+    if (begin >= end) return;
+    if (begin == 0 && end == entryCount) {
+        // Everything: back to a uniform storage
+        palette.assign(1, type);
+        data.clear();
+        data.shrink_to_fit();
+        bits = 0;
+        bitsShift = 0;
+        return;
+    }
+
+    uint32_t paletteIndex = paletteIndexOf(type);
+    if (bits == 0) return; // uniform and `type` is the only entry
+
+    const int perWord = 64 >> bitsShift;
+    const uint64_t pattern = broadcast(paletteIndex, bits);
+    size_t word = begin / perWord;
+    const size_t lastWord = (end - 1) / perWord;
+
+    // Partial words at both ends, whole words in between
+    auto fillPart = [&](size_t w, int first, int last) {
+        uint64_t mask = laneRange(first, last, bits);
+        data[w] = (data[w] & ~mask) | (pattern & mask);
+    };
+    if (word == lastWord) {
+        fillPart(word, static_cast<int>(begin % perWord), static_cast<int>((end - 1) % perWord) + 1);
+        return;
+    }
+    if (begin % perWord != 0) fillPart(word++, static_cast<int>(begin % perWord), perWord);
+    size_t fullEnd = end % perWord == 0 ? lastWord + 1 : lastWord;
+#ifdef PALETTE_SSE2
+    __m128i wide = _mm_set1_epi64x(static_cast<long long>(pattern));
+    for (; word + 2 <= fullEnd; word += 2) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&data[word]), wide);
+    }
+#endif
+    for (; word < fullEnd; word++) data[word] = pattern;
+    if (fullEnd == lastWord) fillPart(lastWord, 0, static_cast<int>((end - 1) % perWord) + 1);
+}
+
+void PaletteStorage::replace(BlockType from, BlockType to) {
+    if (from == to) return;
+    int fromIndex = findPaletteIndex(from);
+    if (fromIndex < 0) return;
+    int toIndex = findPaletteIndex(to);
+    if (toIndex < 0 || bits == 0) {
+        palette[fromIndex] = to; // no index changes
+        return;
+    }
+
+    // Both in the palette: rewrite the `from` indices
+    const uint64_t high = laneHighBits(bits);
+    const uint64_t fromLanes = broadcast(static_cast<uint32_t>(fromIndex), bits);
+    const uint64_t toLanes = broadcast(static_cast<uint32_t>(toIndex), bits);
+    size_t w = 0;
+#ifdef PALETTE_SSE2
+    const __m128i highV = _mm_set1_epi64x(static_cast<long long>(high));
+    const __m128i fromV = _mm_set1_epi64x(static_cast<long long>(fromLanes));
+    const __m128i toV = _mm_set1_epi64x(static_cast<long long>(toLanes));
+    const __m128i shift = _mm_cvtsi32_si128(bits - 1);
+    for (; w + 2 <= data.size(); w += 2) {
+        __m128i* p = reinterpret_cast<__m128i*>(&data[w]);
+        __m128i v = _mm_loadu_si128(p);
+        __m128i hits = zeroLanes(_mm_xor_si128(v, fromV), highV);
+        __m128i mask = _mm_or_si128(hits, _mm_sub_epi64(hits, _mm_srl_epi64(hits, shift)));
+        _mm_storeu_si128(p, _mm_or_si128(_mm_andnot_si128(mask, v), _mm_and_si128(mask, toV)));
+    }
+#endif
+    for (; w < data.size(); w++) {
+        uint64_t mask = widenLanes(zeroLanes(data[w] ^ fromLanes, high), bits);
+        data[w] = (data[w] & ~mask) | (toLanes & mask);
+    }
+}
+
+size_t PaletteStorage::count(BlockType type, size_t begin, size_t end) const {
+    end = std::min(end, entryCount);
+    if (begin >= end) return 0;
+    int paletteIndex = findPaletteIndex(type);
+    if (paletteIndex < 0) return 0;
+    if (bits == 0) return end - begin;
+
+    const int perWord = 64 >> bitsShift;
+    const uint64_t high = laneHighBits(bits);
+    const uint64_t lanes = broadcast(static_cast<uint32_t>(paletteIndex), bits);
+    auto countWord = [&](size_t w, uint64_t range) {
+        return popCount64(zeroLanes(data[w] ^ lanes, high) & range);
+    };
+
+    size_t word = begin / perWord;
+    const size_t lastWord = (end - 1) / perWord;
+    const int first = static_cast<int>(begin % perWord);
+    const int last = static_cast<int>((end - 1) % perWord) + 1;
+    if (word == lastWord) return countWord(word, laneRange(first, last, bits));
+
+    size_t total = countWord(word++, laneRange(first, perWord, bits));
+#ifdef PALETTE_SSE2
+    const __m128i highV = _mm_set1_epi64x(static_cast<long long>(high));
+    const __m128i lanesV = _mm_set1_epi64x(static_cast<long long>(lanes));
+    for (; word + 2 <= lastWord; word += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[word]));
+        uint64_t hits[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(hits), zeroLanes(_mm_xor_si128(v, lanesV), highV));
+        total += popCount64(hits[0]) + popCount64(hits[1]);
+    }
+#endif
+    for (; word < lastWord; word++) total += countWord(word, ~0ull);
+    return total + countWord(lastWord, laneRange(0, last, bits));
+}
+
+bool PaletteStorage::sameContent(const PaletteStorage& other) const {
+    if (bits != other.bits || entryCount != other.entryCount || palette != other.palette) return false;
+    const size_t n = data.size();
+    size_t w = 0;
+#ifdef PALETTE_SSE2
+    for (; w + 2 <= n; w += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[w]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&other.data[w]));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) return false;
+    }
+#endif
+    return std::memcmp(data.data() + w, other.data.data() + w, (n - w) * sizeof(uint64_t)) == 0;
+}
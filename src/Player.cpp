@@ -1,4 +1,5 @@
 #include "../include/Player.h"
+#include "../include/BlockAccessor.h"
 
 Player::Player() {
     position = glm::vec3(0.0f, 1.0f, 3.0f);
@@ -30,28 +31,20 @@ void Player::breakBlock(World& world, Camera& camera) {
 
     const float maxDistance = 10.0f;
     float traveled = 0.0f;
+    // Most steps stay in the same chunk
+    BlockAccessor cursor(world, current);
 
     while (traveled < maxDistance) {
-        if (world.isBlockSolid(current)) {
-            world.removeBlock(current); 
-            glm::ivec3 chunkPos = current / Chunk::CHUNK_SIZE;
+        if (cursor.isSolid()) {
+            cursor.set(AIR);
             return;
         }
 
         // avancer vers la face du voxel la plus proche
-        if (tMax.x < tMax.y && tMax.x < tMax.z) {
-            traveled = tMax.x;
-            tMax.x += tDelta.x;
-            current.x += step.x;
-        } else if (tMax.y < tMax.z) {
-            traveled = tMax.y;
-            tMax.y += tDelta.y;
-            current.y += step.y;
-        } else {
-            traveled = tMax.z;
-            tMax.z += tDelta.z;
-            current.z += step.z;
-        }
+        int axis = (tMax.x < tMax.y && tMax.x < tMax.z) ? 0 : (tMax.y < tMax.z ? 1 : 2);
+        traveled = tMax[axis];
+        tMax[axis] += tDelta[axis];
+        cursor.step(axis, step[axis]);
     }
 }
 
@@ -81,37 +74,25 @@ void Player::placeBlock(World& world, BlockType type, Camera& camera) {
 
     const float maxDistance = 10.0f;
     float traveled = 0.0f;
+    // Most steps stay in the same chunk
+    BlockAccessor cursor(world, current);
 
     glm::ivec3 lastEmpty = current;
 
     while (traveled < maxDistance) {
-        if (world.isBlockSolid(current)) {
-            // place devant le bloc touché
-            Block block;
-            block.position = lastEmpty;
-            block.type = type;
-            world.placeBlock(block);
-            // Generate mesh for affected chunk
-            glm::ivec3 chunkPos = lastEmpty / Chunk::CHUNK_SIZE;
+        if (cursor.isSolid()) {
+            // place devant le bloc touché (crée le chunk si besoin)
+            world.placeBlock(lastEmpty, type);
             return;
         }
 
-        lastEmpty = current;
+        lastEmpty = cursor.position();
 
         // avancer vers la face du voxel la plus proche
-        if (tMax.x < tMax.y && tMax.x < tMax.z) {
-            traveled = tMax.x;
-            tMax.x += tDelta.x;
-            current.x += step.x;
-        } else if (tMax.y < tMax.z) {
-            traveled = tMax.y;
-            tMax.y += tDelta.y;
-            current.y += step.y;
-        } else {
-            traveled = tMax.z;
-            tMax.z += tDelta.z;
-            current.z += step.z;
-        }
+        int axis = (tMax.x < tMax.y && tMax.x < tMax.z) ? 0 : (tMax.y < tMax.z ? 1 : 2);
+        traveled = tMax[axis];
+        tMax[axis] += tDelta[axis];
+        cursor.step(axis, step[axis]);
     }
 }
 
@@ -138,11 +119,13 @@ void Player::jump(float deltaTime) {
 
 void Player::collideWithWorld(World& world) {
     glm::ivec3 blockPos = glm::floor(position);
+    // 36 blocks, one or a few chunks
+    BlockAccessor blocks(world, blockPos);
     for (int x = -1; x <= 1; x++) {
         for (int y = -1; y <= 1; y++) {
             for (int z = -1; z <= 2; z++) {
                 glm::ivec3 neighborPos = blockPos + glm::ivec3(x, y, z);
-                if (!world.isBlockSolid(neighborPos)) continue;
+                if (!blocks.isNeighborSolid(glm::ivec3(x, y, z))) continue;
                 glm::vec3 blockMin = glm::vec3(neighborPos);
                 glm::vec3 blockMax = blockMin + glm::vec3(1.0f);
                 glm::vec3 playerMin = position - glm::vec3(0.5f, 0.0f, 0.5f);
@@ -198,7 +181,9 @@ bool Player::isOnGround(World& world) {
     float epsilon = 0.01f;
     glm::ivec3 minPos = glm::floor(position - glm::vec3(0.5f, epsilon, 0.5f));
     glm::ivec3 maxPos = glm::floor(position + glm::vec3(0.5f, epsilon, 0.5f));
-    float groundY1 = world.getActualHeightAt(minPos.x, minPos.z);
-    float groundY2 = world.getActualHeightAt(maxPos.x, maxPos.z);
+    // Ground under the feet, not the roof of a cave
+    int feetY = static_cast<int>(std::floor(position.y));
+    float groundY1 = world.getActualHeightAt(minPos.x, minPos.z, feetY);
+    float groundY2 = world.getActualHeightAt(maxPos.x, maxPos.z, feetY);
     return (position.y <= groundY1 + 1.0f + epsilon) || (position.y <= groundY2 + 1.0f + epsilon);
 }
@@ -0,0 +1,105 @@
+#include "../include/SectionCache.h"
+#include <algorithm>
+
+SectionCache& SectionCache::instance() {
+    static SectionCache cache;
+    return cache;
+}
+
+
+SectionCache::SectionCache() {
+    for (int type = 0; type < BLOCK_TYPE_COUNT; type++) {
+        uniformSections[type] = std::make_shared<ChunkSection>(static_cast<BlockType>(type));
+    }
+}
+
+
+// FNV-1a over the palette and the packed words
+uint64_t SectionCache::contentHash(const ChunkSection& section) {
+    const PaletteStorage& storage = section.storage();
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const void* bytes, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(bytes);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    int bits = storage.getBitsPerEntry();
+    mix(&bits, sizeof(bits));
+    mix(storage.getPalette().data(), storage.getPalette().size() * sizeof(BlockType));
+    mix(storage.getWords().data(), storage.getWords().size() * sizeof(uint64_t));
+    return hash;
+}
+
+
+SectionCache::SectionPtr SectionCache::intern(const SectionPtr& section) {
+    if (section->isUniform()) return uniform(section->uniformType());
+
+    uint64_t hash = contentHash(*section);
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.lookups++;
+
+    std::vector<SectionPtr>& bucket = buckets[hash];
+    for (const SectionPtr& cached : bucket) {
+        if (cached == section || cached->sameContent(*section)) {
+            stats.hits++;
+            return cached;
+        }
+    }
+    bucket.push_back(section);
+    entryCount++;
+    stats.bytes += section->memoryUsage();
+
+    // Amortized: one full pass each time the cache doubles since the last one
+    if (entryCount >= sweepThreshold) sweep();
+    return section;
+}
+
+
+// Drops the sections only referenced by the cache. Nobody can take a new
+// reference to those but the cache itself, so use_count() == 1 is final.
+void SectionCache::sweep() {
+    for (auto it = buckets.begin(); it != buckets.end();) {
+        std::vector<SectionPtr>& bucket = it->second;
+        for (size_t i = 0; i < bucket.size();) {
+            if (bucket[i].use_count() == 1) {
+                stats.bytes -= bucket[i]->memoryUsage();
+                bucket[i] = std::move(bucket.back());
+                bucket.pop_back();
+                entryCount--;
+            } else {
+                i++;
+            }
+        }
+        it = bucket.empty() ? buckets.erase(it) : std::next(it);
+    }
+    sweepThreshold = std::max<size_t>(2 * entryCount, MIN_SWEEP_THRESHOLD);
+}
+
+
+bool SectionCache::contains(const SectionPtr& section) const {
+    if (section->isUniform()) return false;
+    uint64_t hash = contentHash(*section);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = buckets.find(hash);
+    if (found == buckets.end()) return false;
+    return std::find(found->second.begin(), found->second.end(), section) != found->second.end();
+}
+
+
+size_t SectionCache::trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t before = stats.bytes;
+    sweep();
+    return before - stats.bytes;
+}
+
+
+SectionCache::Stats SectionCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.uniqueSections = entryCount;
+    return result;
+}
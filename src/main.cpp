@@ -13,14 +13,18 @@
 
 #include "../include/Renderer.h"
 #include "../include/World.h"
+#include "../include/ChunkNeighborhood.h"
 #include "../include/Player.h"
 #include "../include/Camera.h"
 #include "../include/Shader.h"
+#include "../include/Benchmark.h"
 
 unsigned int windowedWidth = 1280, windowedHeight = 720;
 unsigned int SCR_WIDTH = windowedWidth;
 unsigned int SCR_HEIGHT = windowedHeight;
 bool cursorDisabled = true;
+// Chunk layers loaded above and below the player (in chunks)
+const int VERTICAL_VIEW_DISTANCE = std::max(1, 64 / Chunk::CHUNK_SIZE.y);
 bool isFullscreen = false;
 
 Player player;
@@ -102,6 +106,15 @@ void processInput(GLFWwindow *window, float deltaTime, World& world) {
         escWasPressed = false;
     }
 
+    static bool f3WasPressed = false;
+    int f3State = glfwGetKey(window, GLFW_KEY_F3);
+    if (f3State == GLFW_PRESS && !f3WasPressed) {
+        world.printMemoryReport();
+        f3WasPressed = true;
+    } else if (f3State == GLFW_RELEASE) {
+        f3WasPressed = false;
+    }
+
     static bool f11WasPressed = false;
     int f11State = glfwGetKey(window, GLFW_KEY_F11);
     if (f11State == GLFW_PRESS && !f11WasPressed) {
@@ -156,24 +169,57 @@ glm::vec3 getLightDir() {
     return glm::normalize(glm::vec3(x, y, z));
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmarks();
+    }
+
     World world;
     
-    std::queue<std::shared_ptr<Chunk>> chunksToUpload;
+    std::queue<ChunkHandle> chunksToUpload;
     std::mutex chunksMutex;
     std::atomic<bool> generatorRunning{true};
 
     std::thread chunkGenerator([&world, &chunksToUpload, &chunksMutex, &generatorRunning](){
+        ChunkNeighborhood hood; // reused from one mesh to the next
+        std::vector<ChunkHandle> pending;
         while(generatorRunning) {
             
-            for(auto& [pos, chunkPtr] : world.chunkMap) {
-                if(!chunkPtr->meshGenerated) {
-                    chunkPtr->generateMesh();
-                    {
-                        std::lock_guard<std::mutex> lock(chunksMutex);
-                        chunksToUpload.push(chunkPtr); // raw pointer pour queue
-                    }
+            // Copy of chunkMap published by the main thread, read without locking.
+            // Chunks unloaded since then have stale handles and fail to pin.
+            ChunkRegistry::Snapshot loaded = world.chunkRegistry.acquire();
+            ChunkPool& pool = world.chunkPool;
+            pending.clear();
+            for(const auto& entry : *loaded) {
+                Chunk* chunk = pool.pin(entry.second); // nullptr if unloaded meanwhile
+                if(!chunk) continue;
+                if(chunk->needsMesh()) pending.push_back(entry.second);
+                pool.unpin(chunk);
+            }
+
+            for(ChunkHandle handle : pending) {
+                Chunk* chunk = pool.pin(handle);
+                if(!chunk) continue;
+                // Pinned until the border is copied, this thread is the only one pinning
+                std::array<Chunk*, ChunkNeighborhood::COUNT> pinned{};
+                ChunkNeighborhood::Neighbors neighbors{};
+                for(int n = 0; n < ChunkNeighborhood::COUNT; n++) {
+                    if(n == ChunkNeighborhood::CENTER) continue;
+                    const ChunkHandle* neighbor = loaded->get(chunk->chunkPos + ChunkNeighborhood::offsetOf(n));
+                    pinned[n] = neighbor ? pool.pin(*neighbor) : nullptr;
+                    neighbors[n] = pinned[n];
                 }
+                hood.build(*chunk, neighbors);
+                for(Chunk* neighbor : pinned) {
+                    if(neighbor) pool.unpin(neighbor);
+                }
+
+                chunk->generateMesh(hood);
+                {
+                    std::lock_guard<std::mutex> lock(chunksMutex);
+                    chunksToUpload.push(handle);
+                }
+                pool.unpin(chunk);
             }
 
             std::this_thread::sleep_for(std::chrono::milliseconds(4));
@@ -197,12 +243,14 @@ int main() {
 
     renderer.init();
     std::cout << "Generating chunks...\n";
-    world.generateChunks(8, glm::ivec3(0,0,0));
+    // Spawn a bit above the terrain, the chunks are loaded around it
+    glm::ivec3 spawn(0, world.getHeightAt(0, 0) + 10, 0);
+    world.generateChunks(8, ChunkLayout::chunkOf(spawn), VERTICAL_VIEW_DISTANCE);
     Shader shader("../shaders/vertex.glsl", "../shaders/fragment.glsl");
     Shader sunShader("../shaders/sun.vert", "../shaders/sun.frag");
     Shader crosshairShader("../shaders/crosshair.vert", "../shaders/crosshair.frag");
 
-    player.position = glm::vec3(0.0f, 137.0f, 0.0f);
+    player.position = glm::vec3(spawn);
     camera.position = player.position;
     camera.yaw = 226.0f;
     camera.pitch = -34.0f;
@@ -242,34 +290,44 @@ int main() {
             static_cast<int>(std::floor(player.position.z / Chunk::CHUNK_SIZE.z))
         };
 
-        auto chunksToDraw = world.getAllChunksToDraw(playerChunkPos, 20); 
+        // Nearest first: chunks are generated from the player outwards, and drawn front to back
+        auto chunksToDraw = world.getAllChunksToDraw(playerChunkPos, 20, VERTICAL_VIEW_DISTANCE); 
 
-        // Generate chunk not generated yet
+        // Generate chunk not generated yet, as long as they fit in the memory budget.
+        // Trees are planted apart: a chunk can exist already, created by a tree from below
         for(const auto& pos : chunksToDraw) {
-            if(!world.getChunkAt(pos)) {
+            Chunk* chunk = world.getChunkAt(pos);
+            if(!chunk && !world.isOverBudget()) {
                 world.createChunkAt(pos);
-                world.generateStructureInChunk(pos);
-            } 
+                chunk = world.getChunkAt(pos);
+            }
+            if(chunk && !chunk->structuresGenerated) world.generateStructureInChunk(pos);
         }
         // Upload sur GPU les chunks prêts
         {
         std::lock_guard<std::mutex> lock(chunksMutex);
             while(!chunksToUpload.empty()) {
-                std::shared_ptr<Chunk> c = chunksToUpload.front();  // conserve le shared_ptr
+                ChunkHandle handle = chunksToUpload.front();
                 chunksToUpload.pop();
-                c->uploadMeshToGPU();
+                // Skips the chunks unloaded since they were meshed
+                if (Chunk* c = world.chunkPool.get(handle)) c->uploadMeshToGPU();
             }
         }
 
-        world.unloadFarChunks(playerChunkPos, 25);
+        world.unloadFarChunks(playerChunkPos, 25, VERTICAL_VIEW_DISTANCE + 1);
+        world.enforceMemoryBudget(playerChunkPos);
+        world.publishChunks(); // for the mesh worker
 
         // Draw chunks
         for(const auto& pos : chunksToDraw) {
             Chunk* chunk = world.getChunkAt(pos);
-            if(chunk && chunk->meshGenerated) {
+            if(!chunk) continue;
+            chunk->lastVisibleFrame = world.frame;
+            if(chunk->meshGenerated) {
                 renderer.drawChunkMesh(*chunk, shader, view, projection, getLightDir());
             }
         }
+        world.frame++;
 
         renderer.drawSun(sunShader, view, projection, getLightDir(), player);
         crosshairShader.use();
@@ -283,6 +341,7 @@ int main() {
     generatorRunning = false;
     if(chunkGenerator.joinable())
         chunkGenerator.join();
+    world.saveAll();
     glfwTerminate();
     return 0;
 }